@@ -1,13 +1,45 @@
 #version 450
 
-layout(location = 0) in vec3 position;
-layout(location = 1) in vec4 color;
-layout(location = 2) in float size;
+// one particle per vertex, colored by its velocity. The cpu renderer streams ParticleVertex
+// (float position, half velocity), a gpu solver binds its position and velocity buffers in place.
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 velocity;
+
+layout(push_constant) uniform Push {
+    vec2 positionScale; // simulation position to [0, 2]
+    float velocityScale; // simulation velocity to pixels per second
+    float pointSize;
+} push;
 
 layout(location = 0) out vec4 fragColor;
 
+const vec3 upColor = vec3(0.996, 0.267, 0.412);
+const vec3 downColor = vec3(0.435, 0.525, 0.984);
+const vec3 leftColor = vec3(0.984, 0.851, 0.353);
+const vec3 rightColor = vec3(0.400, 0.851, 0.549);
+const vec3 darkGray = vec3(0.1, 0.1, 0.1);
+const float maxDisplayVelocityMag = 200.0;
+
+vec3 getParticleColorByVelocity(vec2 v) {
+    float velMagSqr = dot(v, v);
+    if (velMagSqr < 0.00001)
+        return darkGray;
+
+    vec2 velocityDir = normalize(v);
+    if (velMagSqr > maxDisplayVelocityMag * maxDisplayVelocityMag)
+        v = velocityDir * maxDisplayVelocityMag;
+
+    float xIntensity = clamp(abs(v.x) / maxDisplayVelocityMag, 0.0, 1.0);
+    vec3 xColor = mix(darkGray, velocityDir.x > 0.0 ? leftColor : rightColor, xIntensity);
+    float yIntensity = clamp(abs(v.y) / maxDisplayVelocityMag, 0.0, 1.0);
+    vec3 yColor = mix(darkGray, velocityDir.y > 0.0 ? downColor : upColor, yIntensity);
+
+    float intensitySum = xIntensity + yIntensity;
+    return clamp(xColor * xIntensity / intensitySum + yColor * yIntensity / intensitySum, 0.0, 1.0);
+}
+
 void main() {
-    gl_Position = vec4(position, 1.0);
-    gl_PointSize = size;
-    fragColor = color;
+    gl_Position = vec4(position * push.positionScale - vec2(1.0), 0.0, 1.0);
+    gl_PointSize = push.pointSize;
+    fragColor = vec4(getParticleColorByVelocity(velocity * push.velocityScale), 1.0);
 }
@@ -0,0 +1,67 @@
+// shared by the mpm_*.comp passes of GpuMPM, the push constants match GpuMPM::Params
+
+#define WORK_GROUP_SIZE 256
+#define BLOCK_SIZE 8
+#define INVALID_KEY 0xffffffffu
+
+layout(push_constant) uniform Params {
+    uint particleCount;
+    uint sortCount; // entries of the sort buffer, particleCount padded to a power of two
+    uint sortBlockSize; // bitonic merge step, direction changes every sortBlockSize entries
+    uint sortStride; // bitonic compare distance
+    uint elasticStart; // particles are grouped by material, fluid first
+    uint snowStart;
+    uint gridCount;
+    uint nodeCountPerSide; // of the dense grid, the domain plus BLOCK_SIZE nodes on every side
+    int bound;
+    float deltaTime;
+    float dx;
+    float particleMass;
+    float particleVol;
+    float gravity;
+    float fluidBulkModulus;
+    float elasticMu;
+    float elasticLambda;
+    float snowMu;
+    float snowLambda;
+    float snowCriticalCompression;
+    float snowCriticalStretch;
+    float snowHardening;
+} params;
+
+layout(std430, set = 0, binding = 0) buffer PositionBuffer { vec2 position[]; };
+layout(std430, set = 0, binding = 1) buffer VelocityBuffer { vec2 velocity[]; };
+layout(std430, set = 0, binding = 2) buffer CBuffer { mat2 c[]; };
+layout(std430, set = 0, binding = 3) buffer JBuffer { float j[]; };
+layout(std430, set = 0, binding = 4) buffer DeformationBuffer { mat2 deformation[]; };
+layout(std430, set = 0, binding = 5) buffer PlasticJBuffer { float plasticJ[]; };
+layout(std430, set = 0, binding = 6) buffer AffineBuffer { mat2 affine[]; };
+layout(std430, set = 0, binding = 7) buffer SortBuffer { uvec2 sortEntry[]; }; // key, index
+layout(std430, set = 0, binding = 8) buffer GridBuffer { vec2 gridVelocity[]; };
+// float bits of positive values order like the values, so integer atomicMax finds their maximum
+layout(std430, set = 0, binding = 9) buffer StatsBuffer {
+    uint maxSpeedSquared;
+    uint maxHardening;
+};
+
+// base node of the 3x3 stencil, clamped so a stray particle never reaches outside of the grid,
+// the same range as MPM::getBaseNode of the cpu solver
+ivec2 getBaseNode(vec2 gridPos) {
+    ivec2 base = ivec2(floor(gridPos - 0.5));
+    return clamp(base, ivec2(0), ivec2(int(params.gridCount) - 3));
+}
+
+// x major like the blocks of the cpu grid, the nodes of a column are contiguous
+uint getNodeIndex(ivec2 node) {
+    return uint(node.x + BLOCK_SIZE) * params.nodeCountPerSide + uint(node.y + BLOCK_SIZE);
+}
+
+// quadratic b-spline weights of the stencil nodes, per axis
+void getWeights(vec2 localPos, out vec2 w[3]) {
+    vec2 a = 1.5 - localPos;
+    vec2 b = localPos - 1.0;
+    vec2 d = localPos - 0.5;
+    w[0] = 0.5 * a * a;
+    w[1] = 0.75 - b * b;
+    w[2] = 0.5 * d * d;
+}
@@ -0,0 +1,117 @@
+// shared by the sph_*.comp passes of GpuSPH, the push constants match GpuSPH::Params
+
+#define WORK_GROUP_SIZE 256
+#define INVALID_KEY 0xffffffffu
+#define PI 3.14159265359
+
+layout(local_size_x = WORK_GROUP_SIZE) in;
+
+layout(push_constant) uniform Params {
+    uint particleCount;
+    uint sortCount; // entries of the sort buffer, particleCount padded to a power of two
+    uint sortBlockSize; // bitonic merge step, direction changes every sortBlockSize entries
+    uint sortStride; // bitonic compare distance
+    uint stepCount;
+    uint rangeForceMode; // 0 off, 1 attractive, 2 repulsive
+    float deltaTime;
+    float lookAheadTime;
+    float smoothRadius;
+    float targetDensity;
+    float pressureMultiplier;
+    float nearPressureMultiplier;
+    float viscosityMultiplier;
+    float gravityAccValue;
+    float boundaryMultipler;
+    float boundaryMargin;
+    float dataScale;
+    float scaledWindowWidth;
+    float scaledWindowHeight;
+    float scalingFactorPoly6;
+    float scalingFactorSpikyPow3;
+    float scalingFactorSpikyPow2;
+    float rangeForceX;
+    float rangeForceY;
+    float rangeForceScale;
+    float rangeForceRadius;
+} params;
+
+layout(std430, set = 0, binding = 0) buffer PositionBuffer { vec2 position[]; };
+layout(std430, set = 0, binding = 1) buffer VelocityBuffer { vec2 velocity[]; };
+layout(std430, set = 0, binding = 2) buffer PredictedBuffer { vec2 predictedPosition[]; };
+layout(std430, set = 0, binding = 3) buffer DensityBuffer { vec2 density[]; }; // density, near
+layout(std430, set = 0, binding = 4) buffer ForceBuffer { vec2 force[]; };
+layout(std430, set = 0, binding = 5) buffer SortBuffer { uvec2 sortEntry[]; }; // key, index
+layout(std430, set = 0, binding = 6) buffer CellStartBuffer { uint cellStart[]; }; // or INVALID_KEY
+
+const ivec2 offset2D[9] = ivec2[](
+    ivec2(-1, -1), ivec2(0, -1), ivec2(1, -1),
+    ivec2(-1, 0), ivec2(0, 0), ivec2(1, 0),
+    ivec2(-1, 1), ivec2(0, 1), ivec2(1, 1));
+
+// same cell and key as SPH::getSpacialCell and SPH::getSpacialKey in hashed mode
+ivec2 getCell(vec2 position) {
+    return ivec2(position / params.smoothRadius); // truncated like the static_cast on the cpu
+}
+
+uint getKey(ivec2 cell) {
+    int hash = int(uint(cell.x) * 15823u + uint(cell.y) * 9737333u);
+    // % of negative operands is undefined in glsl, take the remainder of the magnitude instead
+    if (hash >= 0)
+        return uint(hash) % params.particleCount;
+    uint remainder = (0u - uint(hash)) % params.particleCount;
+    return remainder == 0u ? 0u : params.particleCount - remainder;
+}
+
+// lve::math::hashUint32
+uint hashUint32(uint x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// SPH::getCoincidentDirection, particle ids are the buffer indices as particles are never reordered
+vec2 getCoincidentDirection(uint particleIndex, uint neighborIndex) {
+    uint hash = hashUint32(params.stepCount);
+    hash = hashUint32(hash ^ particleIndex);
+    hash = hashUint32(hash ^ neighborIndex);
+    float angle = float(hash) * (2.0 * PI / 4294967296.0);
+    return vec2(cos(angle), sin(angle));
+}
+
+float kernelPoly6(float distance) {
+    if (distance >= params.smoothRadius)
+        return 0.0;
+    float v = params.smoothRadius * params.smoothRadius - distance * distance;
+    return params.scalingFactorPoly6 * v * v * v;
+}
+
+float kernelSpikyPow3(float distance) {
+    if (distance >= params.smoothRadius)
+        return 0.0;
+    float v = params.smoothRadius - distance;
+    return params.scalingFactorSpikyPow3 * v * v * v;
+}
+
+float derivativeSpikyPow3(float distance) {
+    if (distance >= params.smoothRadius)
+        return 0.0;
+    float v = params.smoothRadius - distance;
+    return -3.0 * params.scalingFactorSpikyPow3 * v * v;
+}
+
+float kernelSpikyPow2(float distance) {
+    if (distance >= params.smoothRadius)
+        return 0.0;
+    float v = params.smoothRadius - distance;
+    return params.scalingFactorSpikyPow2 * v * v;
+}
+
+float derivativeSpikyPow2(float distance) {
+    if (distance >= params.smoothRadius)
+        return 0.0;
+    float v = params.smoothRadius - distance;
+    return -2.0 * params.scalingFactorSpikyPow2 * v;
+}
@@ -1,9 +1,11 @@
 #include "app.hpp"
 
 // lve
+#include "lve/core/pipeline/pipeline_cache.hpp"
 #include "lve/core/resource/buffer.hpp"
 #include "lve/core/resource/sampler_manager.hpp"
 #include "lve/path.hpp"
+#include "lve/util/checkpoint.hpp"
 #include "lve/util/config.hpp"
 #include "lve/util/file_io.hpp"
 #include "lve/util/math.hpp"
@@ -15,6 +17,8 @@
 #include <cassert>
 #include <chrono>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 #include <thread>
 
 namespace app::fluidsim
@@ -26,52 +30,184 @@ App::App()
                                       .get<std::vector<int>>("windowSize");
     lveWindow.resize(windowSize[0], windowSize[1]);
 
+    // record the simulation if configured
+    const lve::YamlConfig &mpmConfig = lve::ConfigManager::getConfig(lve::path::config::MPM_2D);
+    std::string trajectoryFile = mpmConfig.get<std::string>("trajectoryFile");
+    if (!trajectoryFile.empty())
+        trajectoryWriter = std::make_unique<TrajectoryWriter>(
+            trajectoryFile, fluidParticleSys.getParticleCount(), mpmConfig);
+
     // // register callback functions for window resize
     // lveFrameManager.registerSwapChainResizedCallback(
     //     WINDOW_RESIZED_CALLBACK_NAME, [this](VkExtent2D extent) {
     //     });
 }
 
+MPM App::loadParticleSystem()
+{
+    MPM particleSystem;
+    std::string checkpointFile = lve::ConfigManager::getConfig(lve::path::config::MPM_2D)
+                                     .get<std::string>("loadCheckpoint");
+    if (!checkpointFile.empty())
+    {
+        particleSystem.readCheckpoint(lve::CheckpointReader(checkpointFile));
+        std::cout << "Loaded checkpoint " << checkpointFile << std::endl;
+    }
+    return particleSystem;
+}
+
+std::unique_ptr<GpuMPM> App::createGpuParticleSystem()
+{
+    std::string solver = lve::ConfigManager::getConfig(lve::path::config::MPM_2D)
+                             .get<std::string>("solver");
+    if (solver == "gpu")
+        return std::make_unique<GpuMPM>(lveDevice, fluidParticleSys);
+    if (solver != "cpu")
+        throw std::runtime_error("Unknown MPM solver: " + solver);
+    return nullptr;
+}
+
+void App::saveCheckpoint()
+{
+    std::string checkpointFile = lve::ConfigManager::getConfig(lve::path::config::MPM_2D)
+                                     .get<std::string>("saveCheckpoint");
+    if (gpuParticleSys)
+        gpuParticleSys->downloadState();
+    lve::CheckpointWriter writer(MPM::CHECKPOINT_KIND, MPM::CHECKPOINT_VERSION);
+    fluidParticleSys.writeCheckpoint(writer);
+    writer.write(checkpointFile);
+    std::cout << "Saved checkpoint " << checkpointFile << std::endl;
+}
+
+const ParticleStorage &App::getParticles() const
+{
+    return gpuParticleSys ? gpuParticleSys->getParticles() : fluidParticleSys.getParticles();
+}
+
 void App::run()
 {
+    publishSnapshot(0);
+    std::thread simulationThread(&App::simulationLoop, this);
     std::thread renderThread(&App::renderLoop, this);
 
     lveWindow.mainThreadGlfwEventLoop();
 
     isRunning = false;
     renderThread.join();
+    simulationThread.join();
+    if (trajectoryWriter)
+    {
+        trajectoryWriter->close();
+        std::cout << "Recorded " << trajectoryWriter->getWrittenFrameCount()
+                  << " trajectory frames, dropped " << trajectoryWriter->getDroppedFrameCount()
+                  << std::endl;
+    }
 
     vkDeviceWaitIdle(lveDevice.vkDevice());
 }
 
+void App::publishSnapshot(int substepCount)
+{
+    ParticleSnapshot &snapshot = particleSnapshots.getWriteBuffer();
+    // the gpu solver is drawn from its own buffers, only the substep count is handed over
+    if (!gpuParticleSys)
+        snapshot.particles = getParticles(); // reuses the buffer's allocation
+    snapshot.substepCount = substepCount;
+    particleSnapshots.publish();
+}
+
+void App::simulationLoop()
+{
+    // every tick advances the same simulated time, a tick running late delays the following ones
+    // and a tick more than one period late gives up on catching up
+    float simulationRate = lve::ConfigManager::getConfig(lve::path::config::MPM_2D)
+                               .get<float>("simulationRate");
+    std::chrono::duration<double> tickPeriod(1.0 / simulationRate);
+    std::chrono::steady_clock::time_point nextTick = std::chrono::steady_clock::now();
+    double simulatedTime = 0.0;
+    while (isRunning)
+    {
+        if (gpuParticleSys)
+        {
+            // all substeps of a tick in one submission
+            substepScheduler.plan(
+                tickPeriod.count(),
+                gpuParticleSys->getMaxParticleSpeed() + gpuParticleSys->getWaveSpeed(),
+                gpuParticleSys->getCellSize());
+            gpuParticleSys->update(
+                substepScheduler.getDeltaTime(), substepScheduler.getSubstepCount());
+        }
+        else
+        {
+            substepScheduler.plan(
+                tickPeriod.count(),
+                fluidParticleSys.getMaxParticleSpeed() + fluidParticleSys.getWaveSpeed(),
+                fluidParticleSys.getCellSize());
+            for (int i = 0; i < substepScheduler.getSubstepCount(); i++)
+                fluidParticleSys.substep(substepScheduler.getDeltaTime());
+        }
+        publishSnapshot(substepScheduler.getSubstepCount());
+        simulatedTime += substepScheduler.getSimulatedTime();
+        if (trajectoryWriter)
+            trajectoryWriter->addFrame(getParticles(), simulatedTime);
+        if (saveCheckpointRequested.exchange(false))
+            saveCheckpoint();
+
+        nextTick += std::chrono::duration_cast<std::chrono::steady_clock::duration>(tickPeriod);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (nextTick < now - tickPeriod)
+            nextTick = now;
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
 void App::renderLoop()
 {
     fpsManager.renderStart();
+    bool firstFrame = true;
     while (isRunning)
     {
-        double frameDuration = fpsManager.step([this](int frameCountInLastSecond) {
-            lveWindow.setTitle(APP_NAME + " (FPS: " + std::to_string(frameCountInLastSecond) + ")");
+        fpsManager.step([this](int frameCountInLastSecond) {
+            lveWindow.setTitle(
+                APP_NAME + " (FPS: " + std::to_string(frameCountInLastSecond) + ", substeps: " +
+                std::to_string(particleSnapshots.getReadBuffer().substepCount) + ")");
         });
 
         if (VkCommandBuffer commandBuffer = lveFrameManager.beginFrame())
         {
             handleInput();
 
-            // fluid particle system
-            for (int i = 0; i < 10; i++)
-                fluidParticleSys.substep(1e-4f);
+            // latest finished simulation tick, the previous one is drawn again if none is new
+            particleSnapshots.update();
 
-            // render
+            // render, the gpu solver in place after the updates it submitted so far
+            if (gpuParticleSys)
+                gpuParticleSys->recordRenderBarrier(commandBuffer);
             lveFrameManager.beginSwapChainRenderPass(commandBuffer);
-            dotRenderPipeline.render(commandBuffer);
+            if (gpuParticleSys)
+                dotRenderPipeline.render(
+                    commandBuffer,
+                    gpuParticleSys->getPositionBuffer(),
+                    gpuParticleSys->getVelocityBuffer(),
+                    static_cast<uint32_t>(gpuParticleSys->getParticleCount()),
+                    DotRenderPipeline::UNIT_DOMAIN_DATA_SCALE);
+            else
+                dotRenderPipeline.render(
+                    commandBuffer, particleSnapshots.getReadBuffer().particles);
             // if (fluidParticleSys.isDebugLineOn())
             //     lineRenderPipeline.render(commandBuffer);
 
             lveFrameManager.endSwapChainRenderPass(commandBuffer);
             lveFrameManager.endFrame();
+
+            // the pipelines of the first frame are built by now, a warm start skips most of the
+            // shader compilation
+            if (firstFrame)
+                lveDevice.getPipelineCache().printStats(std::cout);
+            firstFrame = false;
         }
 
         fpsManager.fpsLimitBusyWait();
     }
 }
-} // namespace app::fluidsim
\ No newline at end of file
+} // namespace app::fluidsim
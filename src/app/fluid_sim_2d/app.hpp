@@ -1,7 +1,10 @@
 #pragma once
 
 // app
+#include "gpu_mpm.hpp"
 #include "mpm.hpp"
+#include "substep_scheduler.hpp"
+#include "trajectory.hpp"
 #include "gpu_resources/line_render_pipeline.hpp"
 #include "gpu_resources/dot_render_pipeline.hpp"
 
@@ -15,6 +18,8 @@
 #include "lve/core/resource/sampler_manager.hpp"
 #include "lve/core/window.hpp"
 #include "lve/path.hpp"
+#include "lve/util/config.hpp"
+#include "lve/util/triple_buffer.hpp"
 
 // std
 #include <atomic>
@@ -47,16 +52,32 @@ protected:
 
     lve::FpsManager fpsManager{30, 165};
 
-    MPM fluidParticleSys{};
+    static MPM loadParticleSystem(); // from the checkpoint in the config, if any
+    MPM fluidParticleSys = loadParticleSystem();
+    std::unique_ptr<GpuMPM> createGpuParticleSystem(); // if solver is gpu, null for cpu
+    // stepped and drawn instead of fluidParticleSys if set
+    std::unique_ptr<GpuMPM> gpuParticleSys = createGpuParticleSystem();
+    SubstepScheduler substepScheduler{lve::ConfigManager::getConfig(lve::path::config::MPM_2D)};
+    std::unique_ptr<TrajectoryWriter> trajectoryWriter; // if trajectoryFile is set
 
-    DotRenderPipeline dotRenderPipeline = DotRenderPipeline(lveFrameManager, fluidParticleSys);
+    DotRenderPipeline dotRenderPipeline = DotRenderPipeline(
+        lveFrameManager,
+        fluidParticleSys.getParticleCount(),
+        gpuParticleSys ? DotRenderPipeline::DEVICE_BUFFERS : DotRenderPipeline::HOST_PARTICLES);
     // LineRenderPipeline lineRenderPipeline = LineRenderPipeline(lveFrameManager, fluidParticleSys);
 
     // Input
     void handleInput();
 
-    // Multi-threading
+    // Multi-threading, the simulation runs at a fixed rate on its own thread and hands the
+    // renderer its latest state through particleSnapshots
     std::atomic<bool> isRunning{true};
+    std::atomic<bool> saveCheckpointRequested{false}; // saved by the simulation thread
+    void saveCheckpoint();
+    const ParticleStorage &getParticles() const; // of the solver in use
+    lve::TripleBuffer<ParticleSnapshot> particleSnapshots;
+    void publishSnapshot(int substepCount);
+    void simulationLoop();
     void renderLoop();
 };
 } // namespace app::fluidsim
\ No newline at end of file
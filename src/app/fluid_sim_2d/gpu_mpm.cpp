@@ -0,0 +1,575 @@
+#include "gpu_mpm.hpp"
+
+// lve
+#include "lve/core/pipeline/pipeline_builder.hpp"
+
+// std
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace app::fluidsim
+{
+namespace
+{
+const char *PASS_SHADERS[] = {
+    "mpm_key.comp.spv",
+    "mpm_sort.comp.spv",
+    "mpm_stress.comp.spv",
+    "mpm_p2g.comp.spv",
+    "mpm_g2p.comp.spv"};
+
+// makes the writes of the previous commands visible to the next ones
+void computeBarrier(
+    VkCommandBuffer commandBuffer,
+    VkPipelineStageFlags srcStage,
+    VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage,
+    VkAccessFlags dstAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(
+        commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void computeBarrier(VkCommandBuffer commandBuffer)
+{
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+// the arrays of GpuMPM::copyState in a mapped staging buffer
+struct StateArrays
+{
+    glm::vec2 *position;
+    glm::vec2 *velocity;
+    glm::mat2 *c;
+    float *j;
+    glm::mat2 *deformation;
+    float *plasticJ;
+};
+constexpr size_t STATE_BYTES_PER_PARTICLE =
+    2 * sizeof(glm::vec2) + 2 * sizeof(glm::mat2) + 2 * sizeof(float);
+
+StateArrays getStateArrays(void *mapped, size_t particleCount)
+{
+    StateArrays arrays;
+    arrays.position = static_cast<glm::vec2 *>(mapped);
+    arrays.velocity = arrays.position + particleCount;
+    arrays.c = reinterpret_cast<glm::mat2 *>(arrays.velocity + particleCount);
+    arrays.j = reinterpret_cast<float *>(arrays.c + particleCount);
+    arrays.deformation = reinterpret_cast<glm::mat2 *>(arrays.j + particleCount);
+    arrays.plasticJ = reinterpret_cast<float *>(arrays.deformation + particleCount);
+    return arrays;
+}
+} // namespace
+
+GpuMPM::GpuMPM(lve::Device &device, MPM &hostState)
+    : lveDevice{device}, hostState{hostState}, particleCount{hostState.getParticleCount()}
+{
+    static_assert(BLOCK_SIZE == MPM::BLOCK_SIZE, "node tiles have to match the cpu blocks");
+    if (particleCount == 0 || particleCount >= INVALID_KEY)
+        throw std::runtime_error("GpuMPM needs between 1 and 2^32 - 2 particles");
+
+    sortCount = WORK_GROUP_SIZE;
+    while (sortCount < particleCount)
+        sortCount <<= 1;
+    particleGroupCount =
+        static_cast<uint32_t>((particleCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE);
+    const MPM::SimParams simParams = hostState.getSimParams();
+    tileCountPerSide = static_cast<uint32_t>(simParams.blockTableStride);
+
+    params = {};
+    params.particleCount = static_cast<uint32_t>(particleCount);
+    params.sortCount = sortCount;
+    params.elasticStart = static_cast<uint32_t>(simParams.elasticStart);
+    params.snowStart = static_cast<uint32_t>(simParams.snowStart);
+    params.gridCount = static_cast<uint32_t>(simParams.gridCount);
+    params.nodeCountPerSide = tileCountPerSide * BLOCK_SIZE;
+    params.bound = simParams.bound;
+    params.dx = simParams.dx;
+    params.particleMass = simParams.particleMass;
+    params.particleVol = simParams.particleVol;
+    params.gravity = simParams.gravity;
+    params.fluidBulkModulus = simParams.fluidBulkModulus;
+    params.elasticMu = simParams.elasticMu;
+    params.elasticLambda = simParams.elasticLambda;
+    params.snowMu = simParams.snowMu;
+    params.snowLambda = simParams.snowLambda;
+    params.snowCriticalCompression = simParams.snowCriticalCompression;
+    params.snowCriticalStretch = simParams.snowCriticalStretch;
+    params.snowHardening = simParams.snowHardening;
+    maxParticleSpeed = hostState.getMaxParticleSpeed();
+    timestampsSupported = lveDevice.getProperties().limits.timestampComputeAndGraphics;
+
+    createBuffers();
+    createDescriptorSet();
+    createPipelines();
+    createCommandBuffer();
+    uploadState();
+}
+
+GpuMPM::~GpuMPM()
+{
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(lveDevice.vkDevice(), queryPool, nullptr);
+    if (fence != VK_NULL_HANDLE)
+        vkDestroyFence(lveDevice.vkDevice(), fence, nullptr);
+    if (commandPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(lveDevice.vkDevice(), commandPool, nullptr);
+}
+
+void GpuMPM::createBuffers()
+{
+    auto createDeviceBuffer = [&](VkDeviceSize instanceSize, uint32_t count,
+                                  VkBufferUsageFlags usage) {
+        return std::make_unique<lve::Buffer>(
+            lveDevice,
+            instanceSize,
+            count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    };
+    uint32_t count = static_cast<uint32_t>(particleCount);
+    VkBufferUsageFlags transferUsage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    // drawn in place by the renderer
+    positionBuffer = createDeviceBuffer(
+        sizeof(glm::vec2), count, transferUsage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    velocityBuffer = createDeviceBuffer(
+        sizeof(glm::vec2), count, transferUsage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    cBuffer = createDeviceBuffer(sizeof(glm::mat2), count, transferUsage);
+    jBuffer = createDeviceBuffer(sizeof(float), count, transferUsage);
+    deformationBuffer = createDeviceBuffer(sizeof(glm::mat2), count, transferUsage);
+    plasticJBuffer = createDeviceBuffer(sizeof(float), count, transferUsage);
+    affineBuffer = createDeviceBuffer(sizeof(glm::mat2), count, 0);
+    sortBuffer = createDeviceBuffer(sizeof(glm::uvec2), sortCount, 0);
+    gridBuffer = createDeviceBuffer(
+        sizeof(glm::vec2), params.nodeCountPerSide * params.nodeCountPerSide, 0);
+    statsBuffer = createDeviceBuffer(sizeof(Stats), 1, transferUsage);
+
+    // positions, velocities and the stats in the slot after them
+    static_assert(sizeof(Stats) == sizeof(glm::vec2));
+    stagingBuffer = std::make_unique<lve::Buffer>(
+        lveDevice,
+        sizeof(glm::vec2),
+        2 * count + 1,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer->map();
+    particles.resize(particleCount);
+}
+
+void GpuMPM::createDescriptorSet()
+{
+    lve::Buffer *buffers[] = {
+        positionBuffer.get(),
+        velocityBuffer.get(),
+        cBuffer.get(),
+        jBuffer.get(),
+        deformationBuffer.get(),
+        plasticJBuffer.get(),
+        affineBuffer.get(),
+        sortBuffer.get(),
+        gridBuffer.get(),
+        statsBuffer.get()};
+    const uint32_t bindingCount = static_cast<uint32_t>(std::size(buffers));
+
+    lve::DescriptorSetLayout::Builder layoutBuilder(lveDevice);
+    for (uint32_t binding = 0; binding < bindingCount; binding++)
+        layoutBuilder.addBinding(
+            binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+    descriptorSetLayout = layoutBuilder.build();
+
+    descriptorPool = lve::DescriptorPool::Builder(lveDevice)
+                         .setMaxSets(1)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bindingCount)
+                         .build();
+
+    std::vector<VkDescriptorBufferInfo> bufferInfos(bindingCount);
+    lve::DescriptorWriter writer{*descriptorSetLayout, *descriptorPool};
+    for (uint32_t binding = 0; binding < bindingCount; binding++)
+    {
+        bufferInfos[binding] = buffers[binding]->descriptorInfo();
+        writer.writeBuffer(binding, &bufferInfos[binding]);
+    }
+    if (!writer.allocateDescriptorSet(descriptorSet))
+        throw std::runtime_error("failed to allocate GpuMPM descriptor set");
+    writer.overwrite(descriptorSet);
+}
+
+void GpuMPM::createPipelines()
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(Params);
+
+    // all passes compile at once on the workers of the pipeline builder
+    std::vector<lve::ComputePipelineDescription> descriptions;
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+        descriptions.push_back(
+            {{descriptorSetLayout->getDescriptorSetLayout()},
+             PASS_SHADERS[pass],
+             {pushConstantRange}});
+    std::vector<std::future<std::unique_ptr<lve::ComputePipeline>>> futures =
+        lveDevice.getPipelineBuilder().build(std::move(descriptions));
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+        pipelines[pass] = futures[pass].get();
+}
+
+// the command pool of the device belongs to the render thread, the solver records into its own
+void GpuMPM::createCommandBuffer()
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    if (vkCreateCommandPool(lveDevice.vkDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+        throw std::runtime_error("failed to create GpuMPM command pool");
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(lveDevice.vkDevice(), &allocInfo, &commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to allocate GpuMPM command buffer");
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(lveDevice.vkDevice(), &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+        throw std::runtime_error("failed to create GpuMPM fence");
+}
+
+// without timestamps on compute queues the whole update is timed on the host as binning
+void GpuMPM::reserveQueries(uint32_t substepCount)
+{
+    if (!timestampsSupported || substepCount <= querySubstepCount)
+        return;
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(lveDevice.vkDevice(), queryPool, nullptr);
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = substepCount * (MPM::PHASE_COUNT + 1);
+    if (vkCreateQueryPool(lveDevice.vkDevice(), &queryPoolInfo, nullptr, &queryPool) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create GpuMPM query pool");
+    }
+    querySubstepCount = substepCount;
+}
+
+VkCommandBuffer GpuMPM::beginCommands()
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    return commandBuffer;
+}
+
+void GpuMPM::submitCommands()
+{
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    {
+        std::lock_guard<std::mutex> lock(lveDevice.getQueueMutex());
+        if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &submitInfo, fence) != VK_SUCCESS)
+            throw std::runtime_error("failed to submit GpuMPM command buffer");
+    }
+    vkWaitForFences(lveDevice.vkDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(lveDevice.vkDevice(), 1, &fence);
+}
+
+void GpuMPM::copyState(VkCommandBuffer commandBuffer, lve::Buffer &staging, bool upload)
+{
+    lve::Buffer *buffers[] = {
+        positionBuffer.get(),
+        velocityBuffer.get(),
+        cBuffer.get(),
+        jBuffer.get(),
+        deformationBuffer.get(),
+        plasticJBuffer.get()};
+    VkDeviceSize stagingOffset = 0;
+    for (lve::Buffer *buffer : buffers)
+    {
+        VkDeviceSize size = particleCount * buffer->getInstanceSize();
+        if (upload)
+        {
+            VkBufferCopy copy{stagingOffset, 0, size};
+            vkCmdCopyBuffer(commandBuffer, staging.getBuffer(), buffer->getBuffer(), 1, &copy);
+        }
+        else
+        {
+            VkBufferCopy copy{0, stagingOffset, size};
+            vkCmdCopyBuffer(commandBuffer, buffer->getBuffer(), staging.getBuffer(), 1, &copy);
+        }
+        stagingOffset += size;
+    }
+}
+
+void GpuMPM::uploadState()
+{
+    lve::Buffer staging(
+        lveDevice,
+        STATE_BYTES_PER_PARTICLE,
+        static_cast<uint32_t>(particleCount),
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    staging.map();
+    StateArrays arrays = getStateArrays(staging.getMappedMemory(), particleCount);
+    const ParticleStorage &hostParticles = hostState.getParticles();
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        arrays.position[i] = hostParticles.position[i];
+        arrays.velocity[i] = hostParticles.velocity[i];
+    }
+    std::copy(
+        hostState.getVelocityGradients().begin(), hostState.getVelocityGradients().end(), arrays.c);
+    std::copy(hostState.getVolumeChanges().begin(), hostState.getVolumeChanges().end(), arrays.j);
+    std::copy(
+        hostState.getDeformations().begin(),
+        hostState.getDeformations().end(),
+        arrays.deformation);
+    std::copy(
+        hostState.getPlasticVolumeChanges().begin(),
+        hostState.getPlasticVolumeChanges().end(),
+        arrays.plasticJ);
+
+    copyState(beginCommands(), staging, true);
+    submitCommands();
+    particles = hostParticles;
+}
+
+void GpuMPM::downloadState()
+{
+    lve::Buffer staging(
+        lveDevice,
+        STATE_BYTES_PER_PARTICLE,
+        static_cast<uint32_t>(particleCount),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    staging.map();
+
+    VkCommandBuffer commandBuffer = beginCommands();
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT);
+    copyState(commandBuffer, staging, false);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        VK_ACCESS_HOST_READ_BIT);
+    submitCommands();
+
+    StateArrays arrays = getStateArrays(staging.getMappedMemory(), particleCount);
+    hostState.setParticleState(
+        arrays.position, arrays.velocity, arrays.c, arrays.j, arrays.deformation, arrays.plasticJ);
+}
+
+void GpuMPM::dispatch(
+    VkCommandBuffer commandBuffer, Pass pass, uint32_t groupCountX, uint32_t groupCountY)
+{
+    pipelines[pass]->pushConstants(commandBuffer, &params, sizeof(Params));
+    pipelines[pass]->dispatchComputePipeline(
+        commandBuffer, &descriptorSet, groupCountX, groupCountY);
+}
+
+void GpuMPM::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t query)
+{
+    if (queryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, query);
+}
+
+void GpuMPM::recordSubstep(VkCommandBuffer commandBuffer, float deltaTime, uint32_t firstQuery)
+{
+    params.deltaTime = deltaTime;
+
+    // the previous substep, its readback or a draw of the renderer may still use the buffers
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT |
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    writeTimestamp(commandBuffer, firstQuery);
+
+    // the stress pass maximizes the hardening from that of undeformed snow, g2p the speed from 0
+    vkCmdFillBuffer(
+        commandBuffer, statsBuffer->getBuffer(), offsetof(Stats, maxSpeedSquared), 4, 0);
+    vkCmdFillBuffer(
+        commandBuffer,
+        statsBuffer->getBuffer(),
+        offsetof(Stats, maxHardening),
+        4,
+        std::bit_cast<uint32_t>(1.0f));
+    dispatch(commandBuffer, KEY_PASS, sortCount / WORK_GROUP_SIZE);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    for (uint32_t blockSize = 2; blockSize <= sortCount; blockSize <<= 1)
+    {
+        for (uint32_t stride = blockSize >> 1; stride > 0; stride >>= 1)
+        {
+            params.sortBlockSize = blockSize;
+            params.sortStride = stride;
+            dispatch(commandBuffer, SORT_PASS, sortCount / WORK_GROUP_SIZE);
+            computeBarrier(commandBuffer);
+        }
+    }
+    writeTimestamp(commandBuffer, firstQuery + MPM::BINNING + 1);
+    writeTimestamp(commandBuffer, firstQuery + MPM::ACTIVATE_BLOCKS + 1);
+
+    dispatch(commandBuffer, STRESS_PASS, particleGroupCount);
+    computeBarrier(commandBuffer);
+    writeTimestamp(commandBuffer, firstQuery + MPM::STRESS + 1);
+
+    dispatch(commandBuffer, P2G_PASS, tileCountPerSide, tileCountPerSide);
+    computeBarrier(commandBuffer);
+    writeTimestamp(commandBuffer, firstQuery + MPM::P2G + 1);
+    writeTimestamp(commandBuffer, firstQuery + MPM::GRID_UPDATE + 1);
+
+    dispatch(commandBuffer, G2P_PASS, particleGroupCount);
+    writeTimestamp(commandBuffer, firstQuery + MPM::G2P + 1);
+}
+
+void GpuMPM::update(float deltaTime, int substepCount)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint32_t queryCount = substepCount * (MPM::PHASE_COUNT + 1);
+    reserveQueries(substepCount);
+
+    VkCommandBuffer commandBuffer = beginCommands();
+    if (queryPool != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, queryCount);
+    for (int substep = 0; substep < substepCount; substep++)
+        recordSubstep(commandBuffer, deltaTime, substep * (MPM::PHASE_COUNT + 1));
+
+    // only the stats for the cfl condition, the renderer draws the particles in place
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT);
+    VkBufferCopy statsCopy{0, 2 * particleCount * sizeof(glm::vec2), sizeof(Stats)};
+    vkCmdCopyBuffer(
+        commandBuffer, statsBuffer->getBuffer(), stagingBuffer->getBuffer(), 1, &statsCopy);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        VK_ACCESS_HOST_READ_BIT);
+    submitCommands();
+
+    const glm::vec2 *staging = static_cast<const glm::vec2 *>(stagingBuffer->getMappedMemory());
+    Stats stats = std::bit_cast<Stats>(staging[2 * particleCount]);
+    maxParticleSpeed = std::sqrt(std::bit_cast<float>(stats.maxSpeedSquared));
+    hostState.setMaxSnowHardening(std::bit_cast<float>(stats.maxHardening));
+    particlesOutdated = true;
+
+    if (queryPool == VK_NULL_HANDLE)
+    {
+        phaseTimer.add(
+            MPM::BINNING,
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        return;
+    }
+    std::vector<uint64_t> timestamps(queryCount);
+    vkGetQueryPoolResults(
+        lveDevice.vkDevice(),
+        queryPool,
+        0,
+        queryCount,
+        queryCount * sizeof(uint64_t),
+        timestamps.data(),
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    double secondsPerTick = lveDevice.getProperties().limits.timestampPeriod * 1e-9;
+    for (uint32_t query = 0; query < queryCount; query += MPM::PHASE_COUNT + 1)
+        for (size_t phase = 0; phase < MPM::PHASE_COUNT; phase++)
+            phaseTimer.add(
+                phase,
+                (timestamps[query + phase + 1] - timestamps[query + phase]) * secondsPerTick);
+}
+
+void GpuMPM::recordRenderBarrier(VkCommandBuffer commandBuffer) const
+{
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+const ParticleStorage &GpuMPM::getParticles()
+{
+    if (!particlesOutdated)
+        return particles;
+
+    VkDeviceSize arraySize = particleCount * sizeof(glm::vec2);
+    VkBufferCopy positionCopy{0, 0, arraySize};
+    VkBufferCopy velocityCopy{0, arraySize, arraySize};
+    VkCommandBuffer commandBuffer = beginCommands();
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT);
+    vkCmdCopyBuffer(
+        commandBuffer, positionBuffer->getBuffer(), stagingBuffer->getBuffer(), 1, &positionCopy);
+    vkCmdCopyBuffer(
+        commandBuffer, velocityBuffer->getBuffer(), stagingBuffer->getBuffer(), 1, &velocityCopy);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        VK_ACCESS_HOST_READ_BIT);
+    submitCommands();
+
+    const glm::vec2 *staging = static_cast<const glm::vec2 *>(stagingBuffer->getMappedMemory());
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        particles.position.set(i, staging[i]);
+        particles.velocity.set(i, staging[particleCount + i]);
+    }
+    particlesOutdated = false;
+    return particles;
+}
+} // namespace app::fluidsim
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "mpm.hpp"
+#include "particle_storage.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+#include "lve/core/pipeline/compute_pipeline.hpp"
+#include "lve/core/resource/buffer.hpp"
+#include "lve/core/resource/descriptors.hpp"
+#include "lve/util/phase_timer.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+
+namespace app::fluidsim
+{
+/*
+ * MPM solver in compute shaders with the update rules of MPM. The whole state stays in device
+ * local storage buffers, particles in id order and the grid as one dense array covering the block
+ * table of the cpu solver, the domain plus a ring of one block.
+ *
+ * A substep runs the passes key (stencil base node of every particle), bitonic sort of (key,
+ * index) pairs, stress, particle to grid with the grid update and grid to particle, separated by
+ * compute to compute barriers. Particle to grid gathers the sorted particles of every node tile
+ * through shared memory, see shaders/mpm_p2g.comp, so no pass needs float atomics.
+ *
+ * Positions and velocities are vertex buffers too, the renderer draws them in place and an update
+ * only copies back the statistics of the cfl condition.
+ *
+ * The solver records into its own command pool and locks the queue of the device to submit, so it
+ * can run on another thread than the renderer.
+ */
+class GpuMPM
+{
+public:
+    // copies the parameters and particles of hostState, which keeps the parameters for the cpu
+    // side queries and receives the particle state on downloadState
+    GpuMPM(lve::Device &device, MPM &hostState);
+    ~GpuMPM();
+
+    GpuMPM(const GpuMPM &) = delete;
+    GpuMPM &operator=(const GpuMPM &) = delete;
+
+    // records substepCount substeps in one submission and waits for them, their gpu time is
+    // added to the phase timer and the statistics of the cfl condition are copied back, the
+    // particles stay on the device
+    void update(float deltaTime, int substepCount);
+    void substep(float deltaTime) { update(deltaTime, 1); }
+    // copies the full particle state into hostState, e.g. to write a checkpoint
+    void downloadState();
+
+    size_t getParticleCount() const { return particleCount; }
+    float getCellSize() const { return params.dx; }
+    float getMaxParticleSpeed() const { return maxParticleSpeed; } // after the last update
+    float getWaveSpeed() const { return hostState.getWaveSpeed(); }
+    // downloads positions and velocities on the first call after an update, for trajectories and
+    // validation, the renderer draws the particle buffers in place instead
+    const ParticleStorage &getParticles();
+
+    VkBuffer getPositionBuffer() const { return positionBuffer->getBuffer(); } // vec2 per particle
+    VkBuffer getVelocityBuffer() const { return velocityBuffer->getBuffer(); } // vec2 per particle
+    // makes the particles of every update submitted before commandBuffer visible to its vertex
+    // input, recorded outside of a render pass. An update waits for the draws submitted before it
+    void recordRenderBarrier(VkCommandBuffer commandBuffer) const;
+
+    // the phases of MPM, the grid is dense and updated in particle to grid, so their phases stay 0
+    const lve::PhaseTimer<MPM::PHASE_COUNT> &getPhaseTimer() const { return phaseTimer; }
+    void resetPhaseTimer() { phaseTimer.reset(); }
+
+private:
+    // push constants of every pass, matches Params in shaders/mpm_common.glsl
+    struct Params
+    {
+        uint32_t particleCount;
+        uint32_t sortCount;
+        uint32_t sortBlockSize;
+        uint32_t sortStride;
+        uint32_t elasticStart;
+        uint32_t snowStart;
+        uint32_t gridCount;
+        uint32_t nodeCountPerSide;
+        int32_t bound;
+        float deltaTime;
+        float dx;
+        float particleMass;
+        float particleVol;
+        float gravity;
+        float fluidBulkModulus;
+        float elasticMu;
+        float elasticLambda;
+        float snowMu;
+        float snowLambda;
+        float snowCriticalCompression;
+        float snowCriticalStretch;
+        float snowHardening;
+    };
+    // statistics of a substep, float bits maximized with integer atomics
+    struct Stats
+    {
+        uint32_t maxSpeedSquared;
+        uint32_t maxHardening;
+    };
+    static constexpr uint32_t WORK_GROUP_SIZE = 256; // local_size_x of the particle passes
+    static constexpr uint32_t BLOCK_SIZE = 8;        // node tile of a particle to grid work group
+    static constexpr uint32_t INVALID_KEY = 0xffffffff;
+
+    enum Pass
+    {
+        KEY_PASS,
+        SORT_PASS,
+        STRESS_PASS,
+        P2G_PASS,
+        G2P_PASS,
+        PASS_COUNT
+    };
+
+    lve::Device &lveDevice;
+    MPM &hostState;
+    size_t particleCount;
+    uint32_t sortCount; // particleCount padded to a power of two for the bitonic sort
+    uint32_t particleGroupCount; // work groups of the particle passes
+    uint32_t tileCountPerSide;   // work groups per side of particle to grid
+    Params params;
+    float maxParticleSpeed;
+
+    // device local buffers, bindings 0 to 9 of the descriptor set
+    std::unique_ptr<lve::Buffer> positionBuffer;
+    std::unique_ptr<lve::Buffer> velocityBuffer;
+    std::unique_ptr<lve::Buffer> cBuffer;
+    std::unique_ptr<lve::Buffer> jBuffer;
+    std::unique_ptr<lve::Buffer> deformationBuffer;
+    std::unique_ptr<lve::Buffer> plasticJBuffer;
+    std::unique_ptr<lve::Buffer> affineBuffer;
+    std::unique_ptr<lve::Buffer> sortBuffer;
+    std::unique_ptr<lve::Buffer> gridBuffer;
+    std::unique_ptr<lve::Buffer> statsBuffer;
+    // host visible positions, velocities and stats, the stats are copied back after every update
+    // and the particles by getParticles
+    std::unique_ptr<lve::Buffer> stagingBuffer;
+
+    std::unique_ptr<lve::DescriptorSetLayout> descriptorSetLayout;
+    std::unique_ptr<lve::DescriptorPool> descriptorPool;
+    VkDescriptorSet descriptorSet;
+    std::unique_ptr<lve::ComputePipeline> pipelines[PASS_COUNT];
+
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer;
+    VkFence fence = VK_NULL_HANDLE;
+
+    // timestamp before every substep and after each of its phases
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    uint32_t querySubstepCount = 0; // substeps the query pool has room for
+    bool timestampsSupported;
+    lve::PhaseTimer<MPM::PHASE_COUNT> phaseTimer;
+
+    ParticleStorage particles;
+    bool particlesOutdated = false;
+
+    void createBuffers();
+    void createDescriptorSet();
+    void createPipelines();
+    void createCommandBuffer();
+    void reserveQueries(uint32_t substepCount);
+    void uploadState();
+    VkCommandBuffer beginCommands();
+    void submitCommands(); // and waits for them
+    void recordSubstep(VkCommandBuffer commandBuffer, float deltaTime, uint32_t firstQuery);
+    void dispatch(
+        VkCommandBuffer commandBuffer, Pass pass, uint32_t groupCountX, uint32_t groupCountY = 1);
+    void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t query);
+    // copies position, velocity, c, j, deformation and plasticJ from or to consecutive arrays of a
+    // staging buffer
+    void copyState(VkCommandBuffer commandBuffer, lve::Buffer &staging, bool upload);
+};
+} // namespace app::fluidsim
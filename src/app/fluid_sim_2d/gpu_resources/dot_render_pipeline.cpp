@@ -1,94 +1,120 @@
 #include "dot_render_pipeline.hpp"
 
+// std
+#include <stdexcept>
+
 namespace app::fluidsim
 {
-DotRenderPipeline::DotRenderPipeline(lve::FrameManager &frameManager, MPM &fluidParticleSys)
-    : lveFrameManager{frameManager}, fluidParticleSys{fluidParticleSys}
+std::vector<VkVertexInputBindingDescription> ParticleVertex::getBindingDescriptions()
 {
-    lve::GraphicPipelineConfigInfo dotPipelineConfigInfo;
-    dotPipelineConfigInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
-    dotPipelineConfigInfo.vertFilePath = "dot_2d.vert.spv";
-    dotPipelineConfigInfo.fragFilePath = "dot_2d.frag.spv";
-    dotPipelineConfigInfo.renderPass = lveFrameManager.getSwapChainRenderPass();
-    dotPipelineConfigInfo.vertexBindingDescriptions = lve::Point::getBindingDescriptions();
-    dotPipelineConfigInfo.vertexAttributeDescriptions = lve::Point::getAttributeDescriptions();
-
-    dotRenderPipeline = std::make_unique<lve::GraphicPipeline>(
-        lveFrameManager.getDevice(), lve::GraphicPipelineLayoutConfigInfo{}, dotPipelineConfigInfo);
+    return {{0, sizeof(ParticleVertex), VK_VERTEX_INPUT_RATE_VERTEX}};
 }
 
-const glm::vec3 upColor = glm::vec3(0.996f, 0.267f, 0.412f);
-const glm::vec3 downColor = glm::vec3(0.435f, 0.525f, 0.984f);
-const glm::vec3 leftColor = glm::vec3(0.984f, 0.851f, 0.353f);
-const glm::vec3 rightColor = glm::vec3(0.400f, 0.851f, 0.549f);
-const float maxDisplayVelocityMag = 200.0f;
-const float maxDisplayVelocityMagSqr = maxDisplayVelocityMag * maxDisplayVelocityMag;
-const float medHighVelocityMagSqr = maxDisplayVelocityMagSqr / 4.0f * 3.0f;
-const float medVelocityMagSqr = maxDisplayVelocityMagSqr / 2.0f;
-const glm::vec3 darkGray = glm::vec3(0.1f, 0.1f, 0.1f);
-const glm::vec3 white = glm::vec3(1.0f, 1.0f, 1.0f);
-
-glm::vec3 getParticleColorByVelocity(glm::vec2 v)
+std::vector<VkVertexInputAttributeDescription> ParticleVertex::getAttributeDescriptions()
 {
-    float velMagSqr = glm::dot(v, v);
-    if (velMagSqr < 0.00001f)
-        return darkGray;
-
-    glm::vec2 velocityDir = glm::normalize(v);
-    if (velMagSqr > maxDisplayVelocityMagSqr)
-        v = velocityDir * maxDisplayVelocityMag;
-
-    // find the color based on the velocity magnitude and direction
-    glm::vec3 xColor, yColor;
+    return {
+        {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(ParticleVertex, position)},
+        {1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(ParticleVertex, velocity)}
+    };
+}
 
-    float xIntensity = glm::clamp(glm::abs(v.x) / maxDisplayVelocityMag, 0.0f, 1.0f);
-    if (velocityDir.x > 0.0f)
-        xColor = glm::mix(darkGray, leftColor, xIntensity);
-    else
-        xColor = glm::mix(darkGray, rightColor, xIntensity);
+DotRenderPipeline::DotRenderPipeline(
+    lve::FrameManager &frameManager, size_t maxParticleCount, ParticleSource particleSource)
+    : lveFrameManager{frameManager}, particleSource{particleSource}
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(DotPushConstant);
 
-    float yIntensity = glm::clamp(glm::abs(v.y) / maxDisplayVelocityMag, 0.0f, 1.0f);
-    if (velocityDir.y > 0.0f)
-        yColor = glm::mix(darkGray, downColor, yIntensity);
+    auto configInfo = std::make_unique<lve::GraphicPipelineConfigInfo>();
+    configInfo->inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    configInfo->vertFilePath = "dot_2d.vert.spv";
+    configInfo->fragFilePath = "dot_2d.frag.spv";
+    configInfo->renderPass = lveFrameManager.getSwapChainRenderPass();
+    if (particleSource == HOST_PARTICLES)
+    {
+        pointRing = std::make_unique<lve::FrameVertexRing>(
+            frameManager.getDevice(),
+            sizeof(ParticleVertex),
+            static_cast<uint32_t>(maxParticleCount));
+        configInfo->vertexBindingDescriptions = ParticleVertex::getBindingDescriptions();
+        configInfo->vertexAttributeDescriptions = ParticleVertex::getAttributeDescriptions();
+    }
     else
-        yColor = glm::mix(darkGray, upColor, yIntensity);
+    {
+        // same shader, position and velocity from separate vec2 buffers
+        configInfo->vertexBindingDescriptions = {
+            {0, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX},
+            {1, sizeof(glm::vec2), VK_VERTEX_INPUT_RATE_VERTEX}
+        };
+        configInfo->vertexAttributeDescriptions = {
+            {0, 0, VK_FORMAT_R32G32_SFLOAT, 0},
+            {1, 1, VK_FORMAT_R32G32_SFLOAT, 0}
+        };
+    }
 
-    float intensitySum = xIntensity + yIntensity;
-    return glm::clamp(
-        xColor * xIntensity / intensitySum + yColor * yIntensity / intensitySum, 0.0f, 1.0f);
+    pipelineFuture = lveFrameManager.getDevice().getPipelineBuilder().build(
+        lve::GraphicPipelineDescription{{{}, {pushConstantRange}}, std::move(configInfo)});
 }
 
-void DotRenderPipeline::render(VkCommandBuffer cmdBuffer)
+void DotRenderPipeline::bindPipeline(
+    VkCommandBuffer cmdBuffer, ParticleSource source, float dataScale)
 {
-    pointCollection.clearPoints();
-    dotRenderPipeline->bind(cmdBuffer);
-
-    const float dataScale = 1.0f / 400.0f;
-    const std::vector<glm::vec2> &positionData = fluidParticleSys.getPositionData();
-    const std::vector<glm::vec2> &velocityData = fluidParticleSys.getVelocityData();
-    // const std::vector<int> &firstParticleNeighborIndex =
-    //     fluidParticleSys.getFirstParticleNeighborIndex();
+    if (source != particleSource)
+        throw std::runtime_error("DotRenderPipeline was created for another particle source");
+    if (!pipeline)
+        pipeline = pipelineFuture.get();
+    pipeline->bind(cmdBuffer);
 
     const VkExtent2D extent = lveFrameManager.getWindow().getExtent();
-    const float halfWindowWidth = static_cast<float>(extent.width) * 0.5f;
-    const float halfWindowHeight = static_cast<float>(extent.height) * 0.5f;
+    DotPushConstant push{};
+    push.positionScale = 2.0f / (glm::vec2(extent.width, extent.height) * dataScale);
+    push.velocityScale = 1.0f / dataScale;
+    push.pointSize = 1.0f;
+    vkCmdPushConstants(
+        cmdBuffer,
+        pipeline->getPipelineLayout(),
+        VK_SHADER_STAGE_VERTEX_BIT,
+        0,
+        sizeof(DotPushConstant),
+        &push);
+}
 
-    // Add particles to the point collection
-    std::vector<lve::Point> points;
-    points.reserve(positionData.size());
-    for (size_t i = 0; i < positionData.size(); i++)
-    {
-        glm::vec2 center =
-            positionData[i] / glm::vec2(halfWindowWidth, halfWindowHeight) / dataScale -
-            glm::vec2(1.0f);
-        glm::vec2 velocity = velocityData[i];
-        glm::vec3 color = getParticleColorByVelocity(velocity / dataScale);
+void DotRenderPipeline::render(VkCommandBuffer cmdBuffer, const ParticleStorage &particles)
+{
+    bindPipeline(cmdBuffer, HOST_PARTICLES, UNIT_DOMAIN_DATA_SCALE);
+    const size_t particleCount = particles.getSize();
+    if (particleCount > pointRing->getMaxVertexCount())
+        throw std::runtime_error("Cannot render more particles than the point buffer holds");
+    if (particleCount == 0)
+        return;
 
-        points.push_back(lve::Point{glm::vec3(center, 0.0f), glm::vec4(color, 1.0f), 1.0f});
+    // interleave the particle arrays straight into the mapped vertex buffer of this frame, the
+    // vertex shader does the screen transform and the coloring
+    const int frameIndex = lveFrameManager.getFrameIndex();
+    ParticleVertex *vertices = pointRing->getVertices<ParticleVertex>(frameIndex);
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        vertices[i].position = particles.position[i];
+        vertices[i].velocity = glm::packHalf2x16(particles.velocity[i]);
     }
-    pointCollection.addPoints(points);
-    
-    pointCollection.bind(cmdBuffer);
-    pointCollection.draw(cmdBuffer);
+
+    pointRing->bind(cmdBuffer, frameIndex);
+    vkCmdDraw(cmdBuffer, static_cast<uint32_t>(particleCount), 1, 0, 0);
+}
+
+void DotRenderPipeline::render(
+    VkCommandBuffer cmdBuffer,
+    VkBuffer positionBuffer,
+    VkBuffer velocityBuffer,
+    uint32_t particleCount,
+    float dataScale)
+{
+    bindPipeline(cmdBuffer, DEVICE_BUFFERS, dataScale);
+    VkBuffer buffers[] = {positionBuffer, velocityBuffer};
+    VkDeviceSize offsets[] = {0, 0};
+    vkCmdBindVertexBuffers(cmdBuffer, 0, 2, buffers, offsets);
+    vkCmdDraw(cmdBuffer, particleCount, 1, 0, 0);
 }
-} // namespace app::fluidsim
\ No newline at end of file
+} // namespace app::fluidsim
@@ -1,38 +1,91 @@
 #pragma once
 
-#include "../mpm.hpp"
+#include "../particle_storage.hpp"
 
 // lve
-#include "lve/GO/geo/point.hpp"
 #include "lve/core/frame_manager.hpp"
 #include "lve/core/pipeline/graphics_pipeline.hpp"
+#include "lve/core/pipeline/pipeline_builder.hpp"
 #include "lve/core/resource/buffer.hpp"
 #include "lve/core/resource/descriptors.hpp"
+#include "lve/core/resource/frame_vertex_ring.hpp"
 #include "lve/core/resource/sampler_manager.hpp"
 #include "lve/core/swap_chain.hpp"
 
+// libs
+#include "include/glm.hpp"
+
+// std
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+
 namespace app::fluidsim
 {
+// 12 byte vertex of the cpu particle path, the velocity only picks a color and is stored as half
+// floats, the shader derives screen position and color
+struct ParticleVertex
+{
+    glm::vec2 position;
+    uint32_t velocity; // glm::packHalf2x16
+
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+};
+
 class DotRenderPipeline
 {
+public: // types
+    // a cpu solver hands over a ParticleStorage, a gpu solver its particle buffers
+    enum ParticleSource
+    {
+        HOST_PARTICLES,
+        DEVICE_BUFFERS
+    };
+
 public: // constructors
+    // builds the pipeline and resources of particleSource only
     DotRenderPipeline(
-        lve::FrameManager &frameManager,
-        MPM &fluidParticleSys);
+        lve::FrameManager &frameManager, size_t maxParticleCount, ParticleSource particleSource);
     DotRenderPipeline(const DotRenderPipeline &) = delete;
     DotRenderPipeline &operator=(const DotRenderPipeline &) = delete;
 
+public: // constants
+    // one unit of the MPM domain spans 400 pixels
+    static constexpr float UNIT_DOMAIN_DATA_SCALE = 1.0f / 400.0f;
+
 public: // methods
-    void render(VkCommandBuffer cmdBuffer);
+    // HOST_PARTICLES, writes a ParticleVertex per particle into the vertex buffer of the frame
+    void render(VkCommandBuffer cmdBuffer, const ParticleStorage &particles);
+    // DEVICE_BUFFERS, draws particles of a gpu solver in place, one vec2 per particle in each
+    // buffer
+    void render(
+        VkCommandBuffer cmdBuffer,
+        VkBuffer positionBuffer,
+        VkBuffer velocityBuffer,
+        uint32_t particleCount,
+        float dataScale);
 
 private: // variables
     lve::FrameManager &lveFrameManager;
-    MPM &fluidParticleSys;
+    ParticleSource particleSource;
+
+    // resources, HOST_PARTICLES only
+    std::unique_ptr<lve::FrameVertexRing> pointRing;
+
+    // built on the workers of the pipeline builder, taken from the future on first use
+    std::future<std::unique_ptr<lve::GraphicPipeline>> pipelineFuture;
+    std::unique_ptr<lve::GraphicPipeline> pipeline;
 
-    // resources
-    lve::PointCollection pointCollection{
-        lveFrameManager.getDevice(), fluidParticleSys.getParticleCount()};
+    // push constants of dot_2d.vert, the same for both sources
+    struct DotPushConstant
+    {
+        glm::vec2 positionScale;
+        float velocityScale;
+        float pointSize;
+    };
 
-    std::unique_ptr<lve::GraphicPipeline> dotRenderPipeline;
+    void bindPipeline(VkCommandBuffer cmdBuffer, ParticleSource source, float dataScale);
 };
 } // namespace app::fluidsim
\ No newline at end of file
@@ -6,25 +6,26 @@ LineRenderPipeline::LineRenderPipeline(
     lve::FrameManager &frameManager, SPH &fluidParticleSys)
     : lveFrameManager{frameManager}, fluidParticleSys{fluidParticleSys}
 {
-    lve::GraphicPipelineConfigInfo linePipelineConfigInfo;
-    linePipelineConfigInfo.inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
-    linePipelineConfigInfo.vertFilePath = "line_2d.vert.spv";
-    linePipelineConfigInfo.fragFilePath = "line_2d.frag.spv";
-    linePipelineConfigInfo.renderPass = lveFrameManager.getSwapChainRenderPass();
-    linePipelineConfigInfo.vertexBindingDescriptions = lve::Line::Vertex::getBindingDescriptions();
-    linePipelineConfigInfo.vertexAttributeDescriptions =
+    auto linePipelineConfigInfo = std::make_unique<lve::GraphicPipelineConfigInfo>();
+    linePipelineConfigInfo->inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    linePipelineConfigInfo->vertFilePath = "line_2d.vert.spv";
+    linePipelineConfigInfo->fragFilePath = "line_2d.frag.spv";
+    linePipelineConfigInfo->renderPass = lveFrameManager.getSwapChainRenderPass();
+    linePipelineConfigInfo->vertexBindingDescriptions =
+        lve::Line::Vertex::getBindingDescriptions();
+    linePipelineConfigInfo->vertexAttributeDescriptions =
         lve::Line::Vertex::getAttributeDescriptions();
 
-    lineRenderPipeline = std::make_unique<lve::GraphicPipeline>(
-        lveFrameManager.getDevice(),
-        lve::GraphicPipelineLayoutConfigInfo{},
-        linePipelineConfigInfo);
+    lineRenderPipelineFuture = lveFrameManager.getDevice().getPipelineBuilder().build(
+        lve::GraphicPipelineDescription{{}, std::move(linePipelineConfigInfo)});
 }
 
 void LineRenderPipeline::render(VkCommandBuffer cmdBuffer)
 {
     lineCollection.clearLines();
     lineCollection.addLines(fluidParticleSys.getDebugLines());
+    if (!lineRenderPipeline)
+        lineRenderPipeline = lineRenderPipelineFuture.get();
     lve::renderLines(cmdBuffer, lineRenderPipeline.get(), lineCollection);
 }
 } // namespace app::fluidsim
\ No newline at end of file
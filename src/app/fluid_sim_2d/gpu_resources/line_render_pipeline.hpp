@@ -5,8 +5,12 @@
 // lve
 #include "lve/core/frame_manager.hpp"
 #include "lve/core/pipeline/graphics_pipeline.hpp"
+#include "lve/core/pipeline/pipeline_builder.hpp"
 #include "lve/core/resource/descriptors.hpp"
 
+// std
+#include <future>
+
 namespace app::fluidsim
 {
 class LineRenderPipeline
@@ -27,6 +31,8 @@ private: // variables
     lve::LineCollection lineCollection{
         lveFrameManager.getDevice(), fluidParticleSys.getParticleCount()};
 
+    // built on the workers of the pipeline builder, taken from the future on first use
+    std::future<std::unique_ptr<lve::GraphicPipeline>> lineRenderPipelineFuture;
     std::unique_ptr<lve::GraphicPipeline> lineRenderPipeline;
 };
 } // namespace app::fluidsim
\ No newline at end of file
@@ -0,0 +1,374 @@
+#include "gpu_sph.hpp"
+
+// lve
+#include "lve/core/pipeline/pipeline_builder.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace app::fluidsim
+{
+namespace
+{
+const char *PASS_SHADERS[] = {
+    "sph_hash.comp.spv",
+    "sph_sort.comp.spv",
+    "sph_cell_start.comp.spv",
+    "sph_density.comp.spv",
+    "sph_force.comp.spv",
+    "sph_integrate.comp.spv"};
+
+// makes the writes of the previous commands visible to the next ones
+void computeBarrier(
+    VkCommandBuffer commandBuffer,
+    VkPipelineStageFlags srcStage,
+    VkAccessFlags srcAccess,
+    VkPipelineStageFlags dstStage,
+    VkAccessFlags dstAccess)
+{
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    vkCmdPipelineBarrier(
+        commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void computeBarrier(VkCommandBuffer commandBuffer)
+{
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+} // namespace
+
+GpuSPH::GpuSPH(lve::Device &device, const SPH &initialState)
+    : lveDevice{device}, particleCount{initialState.getParticleCount()}
+{
+    if (particleCount == 0 || particleCount >= INVALID_KEY)
+        throw std::runtime_error("GpuSPH needs between 1 and 2^32 - 2 particles");
+
+    sortCount = WORK_GROUP_SIZE;
+    while (sortCount < particleCount)
+        sortCount <<= 1;
+
+    SPH::SimParams simParams = initialState.getSimParams();
+    params = {};
+    params.particleCount = static_cast<uint32_t>(particleCount);
+    params.sortCount = sortCount;
+    params.lookAheadTime = simParams.lookAheadTime;
+    params.smoothRadius = simParams.smoothRadius;
+    params.targetDensity = simParams.targetDensity;
+    params.pressureMultiplier = simParams.pressureMultiplier;
+    params.nearPressureMultiplier = simParams.nearPressureMultiplier;
+    params.viscosityMultiplier = simParams.viscosityMultiplier;
+    params.gravityAccValue = simParams.gravityAccValue;
+    params.boundaryMultipler = simParams.boundaryMultipler;
+    params.boundaryMargin = simParams.boundaryMargin;
+    params.dataScale = simParams.dataScale;
+    params.scaledWindowWidth = simParams.scaledWindowExtent.x;
+    params.scaledWindowHeight = simParams.scaledWindowExtent.y;
+    params.scalingFactorPoly6 = simParams.scalingFactorPoly6;
+    params.scalingFactorSpikyPow3 = simParams.scalingFactorSpikyPow3;
+    params.scalingFactorSpikyPow2 = simParams.scalingFactorSpikyPow2;
+    params.rangeForceScale = simParams.rangeForceScale;
+    params.rangeForceRadius = simParams.rangeForceRadius;
+    maxDeltaTime = simParams.maxDeltaTime;
+    stepCount = static_cast<uint32_t>(initialState.getStepCount());
+
+    createBuffers();
+    createDescriptorSet();
+    createPipelines();
+    createQueryPool();
+    uploadParticles(initialState);
+}
+
+GpuSPH::~GpuSPH()
+{
+    if (queryPool != VK_NULL_HANDLE)
+        vkDestroyQueryPool(lveDevice.vkDevice(), queryPool, nullptr);
+}
+
+void GpuSPH::createBuffers()
+{
+    auto createDeviceBuffer = [&](VkDeviceSize instanceSize, uint32_t count,
+                                  VkBufferUsageFlags usage) {
+        return std::make_unique<lve::Buffer>(
+            lveDevice,
+            instanceSize,
+            count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | usage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    };
+    uint32_t count = static_cast<uint32_t>(particleCount);
+    VkBufferUsageFlags particleUsage =
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    positionBuffer = createDeviceBuffer(sizeof(glm::vec2), count, particleUsage);
+    velocityBuffer = createDeviceBuffer(sizeof(glm::vec2), count, particleUsage);
+    predictedPositionBuffer = createDeviceBuffer(sizeof(glm::vec2), count, 0);
+    densityBuffer = createDeviceBuffer(sizeof(glm::vec2), count, 0);
+    forceBuffer = createDeviceBuffer(sizeof(glm::vec2), count, 0);
+    sortBuffer = createDeviceBuffer(sizeof(glm::uvec2), sortCount, 0);
+    cellStartBuffer =
+        createDeviceBuffer(sizeof(uint32_t), count, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    stagingBuffer = std::make_unique<lve::Buffer>(
+        lveDevice,
+        sizeof(glm::vec2),
+        2 * count,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    stagingBuffer->map();
+}
+
+void GpuSPH::createDescriptorSet()
+{
+    lve::Buffer *buffers[] = {
+        positionBuffer.get(),
+        velocityBuffer.get(),
+        predictedPositionBuffer.get(),
+        densityBuffer.get(),
+        forceBuffer.get(),
+        sortBuffer.get(),
+        cellStartBuffer.get()};
+    const uint32_t bindingCount = static_cast<uint32_t>(std::size(buffers));
+
+    lve::DescriptorSetLayout::Builder layoutBuilder(lveDevice);
+    for (uint32_t binding = 0; binding < bindingCount; binding++)
+        layoutBuilder.addBinding(
+            binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+    descriptorSetLayout = layoutBuilder.build();
+
+    descriptorPool = lve::DescriptorPool::Builder(lveDevice)
+                         .setMaxSets(1)
+                         .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bindingCount)
+                         .build();
+
+    std::vector<VkDescriptorBufferInfo> bufferInfos(bindingCount);
+    lve::DescriptorWriter writer{*descriptorSetLayout, *descriptorPool};
+    for (uint32_t binding = 0; binding < bindingCount; binding++)
+    {
+        bufferInfos[binding] = buffers[binding]->descriptorInfo();
+        writer.writeBuffer(binding, &bufferInfos[binding]);
+    }
+    if (!writer.allocateDescriptorSet(descriptorSet))
+        throw std::runtime_error("failed to allocate GpuSPH descriptor set");
+    writer.overwrite(descriptorSet);
+}
+
+void GpuSPH::createPipelines()
+{
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(Params);
+
+    // all passes compile at once on the workers of the pipeline builder
+    std::vector<lve::ComputePipelineDescription> descriptions;
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+        descriptions.push_back(
+            {{descriptorSetLayout->getDescriptorSetLayout()},
+             PASS_SHADERS[pass],
+             {pushConstantRange}});
+    std::vector<std::future<std::unique_ptr<lve::ComputePipeline>>> futures =
+        lveDevice.getPipelineBuilder().build(std::move(descriptions));
+    for (int pass = 0; pass < PASS_COUNT; pass++)
+        pipelines[pass] = futures[pass].get();
+}
+
+void GpuSPH::createQueryPool()
+{
+    // without timestamps on compute queues the whole step is timed on the host as hashing
+    if (!lveDevice.getProperties().limits.timestampComputeAndGraphics)
+        return;
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = SPH::PHASE_COUNT + 1;
+    if (vkCreateQueryPool(lveDevice.vkDevice(), &queryPoolInfo, nullptr, &queryPool) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create GpuSPH query pool");
+    }
+}
+
+void GpuSPH::uploadParticles(const SPH &initialState)
+{
+    // the cpu solver may have reordered its data, store it by particle id
+    const ParticleStorage &source = initialState.getParticles();
+    const std::vector<unsigned int> &particleId = initialState.getParticleIdData();
+    glm::vec2 *staging = static_cast<glm::vec2 *>(stagingBuffer->getMappedMemory());
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        staging[particleId[i]] = source.position[i];
+        staging[particleCount + particleId[i]] = source.velocity[i];
+    }
+
+    VkDeviceSize arraySize = particleCount * sizeof(glm::vec2);
+    VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+    VkBufferCopy positionCopy{0, 0, arraySize};
+    VkBufferCopy velocityCopy{arraySize, 0, arraySize};
+    vkCmdCopyBuffer(
+        commandBuffer, stagingBuffer->getBuffer(), positionBuffer->getBuffer(), 1, &positionCopy);
+    vkCmdCopyBuffer(
+        commandBuffer, stagingBuffer->getBuffer(), velocityBuffer->getBuffer(), 1, &velocityCopy);
+    lveDevice.endSingleTimeCommands(commandBuffer);
+
+    particles.resize(particleCount);
+    particlesOutdated = true;
+}
+
+void GpuSPH::setRangeForcePos(bool isRepulsive, glm::vec2 mousePosition)
+{
+    params.rangeForceMode = isRepulsive ? 2 : 1;
+    params.rangeForceX = mousePosition.x * params.dataScale;
+    params.rangeForceY = mousePosition.y * params.dataScale;
+}
+
+void GpuSPH::dispatch(VkCommandBuffer commandBuffer, Pass pass, uint32_t invocationCount)
+{
+    uint32_t groupCount = (invocationCount + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE;
+    pipelines[pass]->pushConstants(commandBuffer, &params, sizeof(Params));
+    pipelines[pass]->dispatchComputePipeline(commandBuffer, &descriptorSet, groupCount, 1);
+}
+
+void GpuSPH::writeTimestamp(VkCommandBuffer commandBuffer, uint32_t query)
+{
+    if (queryPool != VK_NULL_HANDLE)
+        vkCmdWriteTimestamp(
+            commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, query);
+}
+
+void GpuSPH::recordUpdate(VkCommandBuffer commandBuffer, float deltaTime)
+{
+    params.deltaTime = std::min(deltaTime, maxDeltaTime);
+    params.stepCount = ++stepCount; // the cpu solver counts the step before its density pass
+    uint32_t count = static_cast<uint32_t>(particleCount);
+
+    if (queryPool != VK_NULL_HANDLE)
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, SPH::PHASE_COUNT + 1);
+    // the previous step may still be copied back
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    writeTimestamp(commandBuffer, 0);
+
+    vkCmdFillBuffer(commandBuffer, cellStartBuffer->getBuffer(), 0, VK_WHOLE_SIZE, INVALID_KEY);
+    dispatch(commandBuffer, HASH_PASS, sortCount);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    writeTimestamp(commandBuffer, SPH::HASHING + 1);
+
+    for (uint32_t blockSize = 2; blockSize <= sortCount; blockSize <<= 1)
+    {
+        for (uint32_t stride = blockSize >> 1; stride > 0; stride >>= 1)
+        {
+            params.sortBlockSize = blockSize;
+            params.sortStride = stride;
+            dispatch(commandBuffer, SORT_PASS, sortCount);
+            computeBarrier(commandBuffer);
+        }
+    }
+    dispatch(commandBuffer, CELL_START_PASS, count);
+    computeBarrier(commandBuffer);
+    writeTimestamp(commandBuffer, SPH::SORT + 1);
+    writeTimestamp(commandBuffer, SPH::NEIGHBOR_LIST + 1);
+
+    dispatch(commandBuffer, DENSITY_PASS, count);
+    computeBarrier(commandBuffer);
+    writeTimestamp(commandBuffer, SPH::DENSITY + 1);
+
+    dispatch(commandBuffer, FORCE_PASS, count);
+    computeBarrier(commandBuffer);
+    writeTimestamp(commandBuffer, SPH::FORCES + 1);
+
+    dispatch(commandBuffer, INTEGRATE_PASS, count);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    writeTimestamp(commandBuffer, SPH::INTEGRATION + 1);
+
+    params.rangeForceMode = 0;
+    particlesOutdated = true;
+}
+
+void GpuSPH::updateParticleData(float deltaTime)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+    recordUpdate(commandBuffer, deltaTime);
+    lveDevice.endSingleTimeCommands(commandBuffer);
+
+    if (queryPool == VK_NULL_HANDLE)
+    {
+        phaseTimer.add(
+            SPH::HASHING,
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        return;
+    }
+    uint64_t timestamps[SPH::PHASE_COUNT + 1];
+    vkGetQueryPoolResults(
+        lveDevice.vkDevice(),
+        queryPool,
+        0,
+        SPH::PHASE_COUNT + 1,
+        sizeof(timestamps),
+        timestamps,
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    double secondsPerTick = lveDevice.getProperties().limits.timestampPeriod * 1e-9;
+    for (size_t phase = 0; phase < SPH::PHASE_COUNT; phase++)
+        phaseTimer.add(phase, (timestamps[phase + 1] - timestamps[phase]) * secondsPerTick);
+}
+
+const ParticleStorage &GpuSPH::getParticles() const
+{
+    if (!particlesOutdated)
+        return particles;
+
+    VkDeviceSize arraySize = particleCount * sizeof(glm::vec2);
+    VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
+    VkBufferCopy positionCopy{0, 0, arraySize};
+    VkBufferCopy velocityCopy{0, arraySize, arraySize};
+    vkCmdCopyBuffer(
+        commandBuffer, positionBuffer->getBuffer(), stagingBuffer->getBuffer(), 1, &positionCopy);
+    vkCmdCopyBuffer(
+        commandBuffer, velocityBuffer->getBuffer(), stagingBuffer->getBuffer(), 1, &velocityCopy);
+    computeBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT,
+        VK_ACCESS_HOST_READ_BIT);
+    lveDevice.endSingleTimeCommands(commandBuffer);
+
+    const glm::vec2 *staging = static_cast<const glm::vec2 *>(stagingBuffer->getMappedMemory());
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        particles.position.set(i, staging[i]);
+        particles.velocity.set(i, staging[particleCount + i]);
+    }
+    particlesOutdated = false;
+    return particles;
+}
+} // namespace app::fluidsim
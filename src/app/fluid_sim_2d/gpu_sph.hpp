@@ -0,0 +1,139 @@
+#pragma once
+
+#include "particle_storage.hpp"
+#include "sph.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+#include "lve/core/pipeline/compute_pipeline.hpp"
+#include "lve/core/resource/buffer.hpp"
+#include "lve/core/resource/descriptors.hpp"
+#include "lve/util/phase_timer.hpp"
+
+// libs
+#include "include/glm.hpp"
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+
+namespace app::fluidsim
+{
+/*
+ * SPH solver in compute shaders, the update rules of SPH with the hashed neighbor search and
+ * without neighbor list or reordering. Particle data stays in device local storage buffers. It is
+ * run by fluid-bench only, the app simulates MPM.
+ *
+ * A step runs the passes hash (predicted position and key), bitonic sort of (key, index) pairs,
+ * cell start table, density, forces and integration, separated by compute to compute barriers.
+ */
+class GpuSPH
+{
+public:
+    // copies the parameters and particles of the cpu solver, particles are stored in id order
+    GpuSPH(lve::Device &device, const SPH &initialState);
+    ~GpuSPH();
+
+    GpuSPH(const GpuSPH &) = delete;
+    GpuSPH &operator=(const GpuSPH &) = delete;
+
+    // records, submits and waits for a step, its gpu time is added to the phase timer
+    void updateParticleData(float deltaTime);
+
+    size_t getParticleCount() const { return particleCount; }
+    float getSmoothRadius() const { return params.smoothRadius; }
+    float getDataScale() const { return params.dataScale; }
+    // copied back from the device on the first call after a step
+    const ParticleStorage &getParticles() const;
+
+    void setRangeForcePos(bool isRepulsive, glm::vec2 mousePosition);
+
+    // the phases of SPH, the neighbor list phase stays 0
+    const lve::PhaseTimer<SPH::PHASE_COUNT> &getPhaseTimer() const { return phaseTimer; }
+    void resetPhaseTimer() { phaseTimer.reset(); }
+
+private:
+    // push constants of every pass, matches Params in shaders/sph_common.glsl
+    struct Params
+    {
+        uint32_t particleCount;
+        uint32_t sortCount;
+        uint32_t sortBlockSize;
+        uint32_t sortStride;
+        uint32_t stepCount;
+        uint32_t rangeForceMode; // 0 off, 1 attractive, 2 repulsive
+        float deltaTime;
+        float lookAheadTime;
+        float smoothRadius;
+        float targetDensity;
+        float pressureMultiplier;
+        float nearPressureMultiplier;
+        float viscosityMultiplier;
+        float gravityAccValue;
+        float boundaryMultipler;
+        float boundaryMargin;
+        float dataScale;
+        float scaledWindowWidth;
+        float scaledWindowHeight;
+        float scalingFactorPoly6;
+        float scalingFactorSpikyPow3;
+        float scalingFactorSpikyPow2;
+        float rangeForceX;
+        float rangeForceY;
+        float rangeForceScale;
+        float rangeForceRadius;
+    };
+    static constexpr uint32_t WORK_GROUP_SIZE = 256; // local_size_x of the shaders
+    static constexpr uint32_t INVALID_KEY = 0xffffffff;
+
+    enum Pass
+    {
+        HASH_PASS,
+        SORT_PASS,
+        CELL_START_PASS,
+        DENSITY_PASS,
+        FORCE_PASS,
+        INTEGRATE_PASS,
+        PASS_COUNT
+    };
+
+    lve::Device &lveDevice;
+    size_t particleCount;
+    uint32_t sortCount; // particleCount padded to a power of two for the bitonic sort
+    Params params;
+    float maxDeltaTime;
+    uint32_t stepCount;
+
+    // device local buffers, bindings 0 to 6 of the descriptor set
+    std::unique_ptr<lve::Buffer> positionBuffer;
+    std::unique_ptr<lve::Buffer> velocityBuffer;
+    std::unique_ptr<lve::Buffer> predictedPositionBuffer;
+    std::unique_ptr<lve::Buffer> densityBuffer;
+    std::unique_ptr<lve::Buffer> forceBuffer;
+    std::unique_ptr<lve::Buffer> sortBuffer;
+    std::unique_ptr<lve::Buffer> cellStartBuffer;
+    std::unique_ptr<lve::Buffer> stagingBuffer; // host visible positions and velocities
+
+    std::unique_ptr<lve::DescriptorSetLayout> descriptorSetLayout;
+    std::unique_ptr<lve::DescriptorPool> descriptorPool;
+    VkDescriptorSet descriptorSet;
+    std::unique_ptr<lve::ComputePipeline> pipelines[PASS_COUNT];
+
+    // timestamp before the step and after every phase
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    lve::PhaseTimer<SPH::PHASE_COUNT> phaseTimer;
+
+    mutable ParticleStorage particles;
+    mutable bool particlesOutdated = false;
+
+    void createBuffers();
+    void createDescriptorSet();
+    void createPipelines();
+    void createQueryPool();
+    void uploadParticles(const SPH &initialState);
+    void recordUpdate(VkCommandBuffer commandBuffer, float deltaTime);
+    void dispatch(VkCommandBuffer commandBuffer, Pass pass, uint32_t invocationCount);
+    void writeTimestamp(VkCommandBuffer commandBuffer, uint32_t query);
+};
+} // namespace app::fluidsim
@@ -7,6 +7,10 @@ namespace app::fluidsim
 {
 void App::handleInput()
 {
+    lveWindow.input.oneTimeKeyUse(GLFW_KEY_C, [this] {
+        saveCheckpointRequested = true;
+    });
+
     // if (lveWindow.input.isMouseButtonPressed(GLFW_MOUSE_BUTTON_LEFT) ||
     //     lveWindow.input.isMouseButtonPressed(GLFW_MOUSE_BUTTON_RIGHT))
     // {
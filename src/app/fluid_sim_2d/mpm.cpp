@@ -1,127 +1,606 @@
 #include "mpm.hpp"
 
 // lve
+#include "lve/path.hpp"
 #include "lve/util/math.hpp"
 
 // std
+#include <algorithm>
 #include <array>
+#include <cmath>
+#include <cstring>
 #include <omp.h>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace app::fluidsim
 {
 MPM::MPM()
+    : MPM(lve::ConfigManager::getConfig(lve::path::config::MPM_2D).get<size_t>("particleCount"))
 {
-    x.resize(particleCount);
-    v.resize(particleCount);
+}
+
+MPM::MPM(size_t particleCount)
+    : MPM(particleCount,
+          lve::ConfigManager::getConfig(lve::path::config::MPM_2D).get<size_t>("gridCount"))
+{
+}
+
+MPM::MPM(size_t particleCount, size_t gridCount)
+    : particleCount(particleCount), gridCount(gridCount)
+{
+    if (gridCount < BLOCK_SIZE)
+        throw std::runtime_error(
+            "MPM grid needs at least " + std::to_string(BLOCK_SIZE) + " cells");
+
+    const lve::YamlConfig &config = lve::ConfigManager::getConfig(lve::path::config::MPM_2D);
+    initGrid();
+    initSimParams(config);
+    rng.seed(config.get<uint32_t>("seed"));
+    initParticleData(config);
+}
+
+void MPM::initGrid()
+{
+    dx = 1.0f / gridCount;
+    blockCountPerSide = (gridCount + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    blockTableStride = blockCountPerSide + 2;
+    blockStart.assign(blockTableStride * blockTableStride + 1, 0);
+    blockSlot.assign(blockTableStride * blockTableStride, INVALID_SLOT);
+    activeBlocks.clear();
+    occupiedBlocks.clear();
+}
+
+MPM::Material MPM::parseMaterial(const std::string &name)
+{
+    if (name == "fluid")
+        return FLUID;
+    if (name == "elastic")
+        return ELASTIC;
+    if (name == "snow")
+        return SNOW;
+    throw std::runtime_error("Unknown MPM material: " + name);
+}
+
+void MPM::initSimParams(const lve::YamlConfig &config)
+{
+    particleRho = config.get<float>("particleDensity");
+    particleVol = dx * dx * 0.25f;
+    particleMass = particleRho * particleVol;
+    gravity = config.get<float>("gravity");
+    bound = config.get<int>("boundWidth");
+
+    fluidBulkModulus = config.get<float>("fluidBulkModulus");
+
+    float youngModulus = config.get<float>("elasticYoungModulus");
+    float poissonRatio = config.get<float>("elasticPoissonRatio");
+    elasticMu = youngModulus / (2.0f * (1.0f + poissonRatio));
+    elasticLambda =
+        youngModulus * poissonRatio / ((1.0f + poissonRatio) * (1.0f - 2.0f * poissonRatio));
+
+    youngModulus = config.get<float>("snowYoungModulus");
+    poissonRatio = config.get<float>("snowPoissonRatio");
+    snowMu = youngModulus / (2.0f * (1.0f + poissonRatio));
+    snowLambda =
+        youngModulus * poissonRatio / ((1.0f + poissonRatio) * (1.0f - 2.0f * poissonRatio));
+    snowCriticalCompression = config.get<float>("snowCriticalCompression");
+    snowCriticalStretch = config.get<float>("snowCriticalStretch");
+    snowHardening = config.get<float>("snowHardening");
+}
+
+void MPM::resizeParticleData()
+{
+    particles.resize(particleCount);
     c.resize(particleCount);
     j.resize(particleCount);
+    materialData.resize(particleCount);
+    deformation.resize(particleCount);
+    plasticJ.resize(particleCount);
+    affine.resize(particleCount);
+    particleBlock.resize(particleCount);
+    binnedParticles.resize(particleCount);
+}
+
+/*
+ * Fill the boxes of the config with particles in proportion to their area. Boxes are filled in
+ * material order, so the particles of every material form one range starting at materialStart.
+ */
+void MPM::initParticleData(const lve::YamlConfig &config)
+{
+    std::vector<std::string> boxMaterialNames =
+        config.get<std::vector<std::string>>("boxMaterial");
+    std::vector<std::vector<float>> boxMin = config.get<std::vector<std::vector<float>>>("boxMin");
+    std::vector<std::vector<float>> boxMax = config.get<std::vector<std::vector<float>>>("boxMax");
+    size_t boxCount = boxMaterialNames.size();
+    if (boxCount == 0 || boxMin.size() != boxCount || boxMax.size() != boxCount)
+        throw std::runtime_error("boxMaterial, boxMin and boxMax need the same number of boxes");
 
-    gridVel.resize(gridCount);
-    gridMass.resize(gridCount);
-    for (size_t i = 0; i < gridCount; i++)
+    std::vector<Material> boxMaterial(boxCount);
+    std::vector<double> boxArea(boxCount);
+    double totalArea = 0.0;
+    for (size_t box = 0; box < boxCount; box++)
     {
-        gridVel[i].resize(gridCount);
-        gridMass[i].resize(gridCount);
+        if (boxMin[box].size() != 2 || boxMax[box].size() != 2)
+            throw std::runtime_error("MPM box corners need 2 coordinates");
+        boxMaterial[box] = parseMaterial(boxMaterialNames[box]);
+        boxArea[box] = (boxMax[box][0] - boxMin[box][0]) * (boxMax[box][1] - boxMin[box][1]);
+        totalArea += boxArea[box];
     }
 
-    std::mt19937 gen(std::random_device{}());
-    std::uniform_real_distribution<float> dis(0.2f, 0.6f);
-    for (size_t i = 0; i < particleCount; i++)
+    resizeParticleData();
+    std::fill(c.begin(), c.end(), glm::mat2(0.0f));
+    std::fill(j.begin(), j.end(), 1.0f);
+    std::fill(deformation.begin(), deformation.end(), glm::mat2(1.0f));
+    std::fill(plasticJ.begin(), plasticJ.end(), 1.0f);
+
+    std::uniform_real_distribution<float> dis(0.0f, 1.0f);
+    size_t i = 0;
+    size_t filledBoxCount = 0;
+    double filledArea = 0.0;
+    for (int material = 0; material < MATERIAL_COUNT; material++)
     {
-        x[i] = glm::vec2(dis(gen), dis(gen));
-        v[i] = glm::vec2(0.0f, 0.0f);
-        j[i] = 1.0f;
+        materialStart[material] = i;
+        for (size_t box = 0; box < boxCount; box++)
+        {
+            if (boxMaterial[box] != material)
+                continue;
+
+            // running total keeps the box counts summing up to particleCount
+            filledArea += boxArea[box];
+            size_t boxEnd = ++filledBoxCount == boxCount
+                                ? particleCount
+                                : static_cast<size_t>(particleCount * filledArea / totalArea + 0.5);
+            glm::vec2 corner = glm::vec2(boxMin[box][0], boxMin[box][1]);
+            glm::vec2 size = glm::vec2(boxMax[box][0], boxMax[box][1]) - corner;
+            for (; i < boxEnd; i++)
+            {
+                float positionX = dis(rng);
+                particles.position.set(i, corner + size * glm::vec2(positionX, dis(rng)));
+                particles.velocity.set(i, glm::vec2(0.0f, 0.0f));
+                materialData[i] = static_cast<Material>(material);
+            }
+        }
     }
+    materialStart[MATERIAL_COUNT] = i;
 }
 
 void MPM::substep(float deltaTime)
 {
-    // clear grid
-    for (size_t i = 0; i < gridCount; i++)
+    phaseTimer.start();
+
+    binParticlesByBlock();
+    phaseTimer.lap(BINNING);
+
+    activateBlocks();
+    phaseTimer.lap(ACTIVATE_BLOCKS);
+
+    computeStress(deltaTime);
+    phaseTimer.lap(STRESS);
+
+    // particle to grid, a particle writes up to 2 nodes past its block, so blocks of the same
+    // 2x2 color are at least one block apart and can scatter concurrently without atomics. Every
+    // node is written in a fixed order (color, then particles of one block in index order), the
+    // result does not depend on the number of threads.
+    for (int color = 0; color < 4; color++)
     {
-        for (size_t j = 0; j < gridCount; j++)
+#pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < occupiedBlocks.size(); k++)
         {
-            gridVel[i][j] = glm::vec2(0.0f, 0.0f);
-            gridMass[i][j] = 0.0f;
+            size_t block = occupiedBlocks[k];
+            size_t blockX = block / blockTableStride;
+            size_t blockY = block % blockTableStride;
+            if ((blockX & 1) + 2 * (blockY & 1) != color)
+                continue;
+
+            for (size_t i = blockStart[block]; i < blockStart[block + 1]; i++)
+                scatterParticleToGrid(binnedParticles[i], deltaTime);
         }
     }
-    // particle to grid
-    for (size_t p = 0; p < particleCount; p++)
+    phaseTimer.lap(P2G);
+
+    // grid boundary and gravity
+#pragma omp parallel for
+    for (int slot = 0; slot < activeBlocks.size(); slot++)
     {
-        glm::vec2 gridPos = x[p] / dx;
-        glm::vec2 baseCoord = glm::floor(gridPos - glm::vec2(0.5f, 0.5f));
-        glm::vec2 localPos = gridPos - glm::vec2(baseCoord);
-        std::array<glm::vec2, 3> w = {
-            0.5f * lve::math::square(1.5f - localPos),
-            0.75f - lve::math::square(localPos - 1.0f),
-            0.5f * lve::math::square(localPos - 0.5f)};
-        float stress = -deltaTime * 4.0f * E * particleVol * (j[p] - 1.0f) * gridCount * gridCount;
-        glm::mat2 affine = glm::mat2(stress, 0.0f, 0.0f, stress) + particleMass * c[p];
-        for (size_t i = 0; i < 3; i++)
+        int originX = (static_cast<int>(activeBlocks[slot] / blockTableStride) - 1) * BLOCK_SIZE;
+        int originY = (static_cast<int>(activeBlocks[slot] % blockTableStride) - 1) * BLOCK_SIZE;
+        glm::vec3 *block = &blockPool[slot * BLOCK_NODE_COUNT];
+        for (int localX = 0; localX < BLOCK_SIZE; localX++)
         {
-            for (size_t j = 0; j < 3; j++)
+            for (int localY = 0; localY < BLOCK_SIZE; localY++)
             {
-                glm::vec2 offset = glm::vec2(i, j);
-                glm::vec2 dpos = (offset - localPos) * dx;
-                float weight = w[i].x * w[j].y;
-                gridVel[baseCoord.x + i][baseCoord.y + j] +=
-                    weight * (particleMass * v[p] + affine * dpos);
-                gridMass[baseCoord.x + i][baseCoord.y + j] += weight * particleMass;
+                int i = originX + localX;
+                int j = originY + localY;
+                glm::vec3 &node = block[(localX << BLOCK_SHIFT) + localY];
+                if (node.z > 0.0f)
+                {
+                    node.x /= node.z;
+                    node.y /= node.z;
+                }
+
+                node.y += gravity * deltaTime;
+
+                if (i < bound && node.x < 0.0f)
+                    node.x = 0.0f;
+                else if (i > static_cast<int>(gridCount) - bound && node.x > 0.0f)
+                    node.x = 0.0f;
+                if (j < bound && node.y < 0.0f)
+                    node.y = 0.0f;
+                else if (j > static_cast<int>(gridCount) - bound && node.y > 0.0f)
+                    node.y = 0.0f;
             }
         }
     }
-    // grid boundary and gravity
-    for (size_t i = 0; i < gridCount; i++)
+    phaseTimer.lap(GRID_UPDATE);
+
+    // grid to particle
+#pragma omp parallel for
+    for (int p = 0; p < particleCount; p++)
+        gatherParticleFromGrid(p, deltaTime);
+    phaseTimer.lap(G2P);
+}
+
+/*
+ * Counting sort of particles by the BLOCK_SIZE x BLOCK_SIZE block holding the base node of their
+ * 3x3 stencil. Stable, particles of a block stay in index order. The stencil base is clamped into
+ * the grid and blocks to the block table, so a stray particle never writes outside of it.
+ */
+void MPM::binParticlesByBlock()
+{
+    int maxBlock = static_cast<int>(blockCountPerSide) - 1;
+#pragma omp parallel for
+    for (int p = 0; p < particleCount; p++)
+    {
+        glm::ivec2 base = getBaseNode(particles.position[p] / dx);
+        int blockX = std::clamp(base.x >> BLOCK_SHIFT, -1, maxBlock);
+        int blockY = std::clamp(base.y >> BLOCK_SHIFT, -1, maxBlock);
+        particleBlock[p] = static_cast<unsigned int>(getBlockTableIndex(blockX, blockY));
+    }
+
+    std::fill(blockStart.begin(), blockStart.end(), 0);
+    for (size_t p = 0; p < particleCount; p++)
+        blockStart[particleBlock[p] + 1]++;
+    for (size_t block = 1; block < blockStart.size(); block++)
+        blockStart[block] += blockStart[block - 1];
+
+    // scatter with a running cursor per block, blockStart is shifted back afterwards
+    for (size_t p = 0; p < particleCount; p++)
+        binnedParticles[blockStart[particleBlock[p]]++] = static_cast<unsigned int>(p);
+    for (size_t block = blockStart.size() - 1; block > 0; block--)
+        blockStart[block] = blockStart[block - 1];
+    blockStart[0] = 0;
+}
+
+void MPM::activateBlock(size_t tableIndex)
+{
+    if (blockSlot[tableIndex] != INVALID_SLOT)
+        return;
+    blockSlot[tableIndex] = static_cast<unsigned int>(activeBlocks.size());
+    activeBlocks.push_back(static_cast<unsigned int>(tableIndex));
+}
+
+/*
+ * Activate every block a particle stencil reaches, the block of the stencil base and its +x, +y
+ * and +xy neighbors, and clear their nodes. Blocks of the previous substep are released first,
+ * only active blocks are ever touched. Slots are assigned in block table order, so the pool
+ * layout does not depend on the number of threads.
+ */
+void MPM::activateBlocks()
+{
+    for (unsigned int tableIndex : activeBlocks)
+        blockSlot[tableIndex] = INVALID_SLOT;
+    activeBlocks.clear();
+    occupiedBlocks.clear();
+
+    size_t tableSize = blockTableStride * blockTableStride;
+    for (size_t block = 0; block < tableSize; block++)
+    {
+        if (blockStart[block] == blockStart[block + 1])
+            continue;
+        occupiedBlocks.push_back(static_cast<unsigned int>(block));
+        activateBlock(block);
+        activateBlock(block + 1);
+        activateBlock(block + blockTableStride);
+        activateBlock(block + blockTableStride + 1);
+    }
+
+    size_t nodeCount = activeBlocks.size() * BLOCK_NODE_COUNT;
+    if (blockPool.size() < nodeCount)
+        blockPool.resize(nodeCount);
+    std::memset(blockPool.data(), 0, nodeCount * sizeof(glm::vec3));
+}
+
+MPM::SimParams MPM::getSimParams() const
+{
+    return {
+        gridCount,
+        blockTableStride,
+        materialStart[ELASTIC],
+        materialStart[SNOW],
+        dx,
+        bound,
+        particleMass,
+        particleVol,
+        gravity,
+        fluidBulkModulus,
+        elasticMu,
+        elasticLambda,
+        snowMu,
+        snowLambda,
+        snowCriticalCompression,
+        snowCriticalStretch,
+        snowHardening};
+}
+
+void MPM::setParticleState(
+    const glm::vec2 *position,
+    const glm::vec2 *velocity,
+    const glm::mat2 *velocityGradient,
+    const float *volumeChange,
+    const glm::mat2 *deformationGradient,
+    const float *plasticVolumeChange)
+{
+    for (size_t p = 0; p < particleCount; p++)
+    {
+        particles.position.set(p, position[p]);
+        particles.velocity.set(p, velocity[p]);
+    }
+    std::copy(velocityGradient, velocityGradient + particleCount, c.begin());
+    std::copy(volumeChange, volumeChange + particleCount, j.begin());
+    std::copy(deformationGradient, deformationGradient + particleCount, deformation.begin());
+    std::copy(plasticVolumeChange, plasticVolumeChange + particleCount, plasticJ.begin());
+}
+
+void MPM::writeCheckpoint(lve::CheckpointWriter &writer) const
+{
+    CheckpointParams params{};
+    params.particleCount = particleCount;
+    params.gridCount = gridCount;
+    for (int material = 0; material <= MATERIAL_COUNT; material++)
+        params.materialStart[material] = materialStart[material];
+    params.particleRho = particleRho;
+    params.particleVol = particleVol;
+    params.particleMass = particleMass;
+    params.gravity = gravity;
+    params.bound = bound;
+    params.fluidBulkModulus = fluidBulkModulus;
+    params.elasticMu = elasticMu;
+    params.elasticLambda = elasticLambda;
+    params.snowMu = snowMu;
+    params.snowLambda = snowLambda;
+    params.snowCriticalCompression = snowCriticalCompression;
+    params.snowCriticalStretch = snowCriticalStretch;
+    params.snowHardening = snowHardening;
+    params.maxSnowHardening = maxSnowHardening;
+    writer.addValue("params", params);
+
+    writeParticleArray(writer, "position", particles.position);
+    writeParticleArray(writer, "velocity", particles.velocity);
+    writer.addArray("c", c);
+    writer.addArray("j", j);
+    writer.addArray("material", materialData);
+    writer.addArray("deformation", deformation);
+    writer.addArray("plasticJ", plasticJ);
+
+    std::ostringstream rngState;
+    rngState << rng;
+    std::string rngText = rngState.str();
+    writer.addSection("rng", rngText.data(), rngText.size());
+}
+
+void MPM::readCheckpoint(const lve::CheckpointReader &reader)
+{
+    reader.checkKind(CHECKPOINT_KIND, CHECKPOINT_VERSION);
+    CheckpointParams params = reader.getValue<CheckpointParams>("params");
+
+    particleCount = params.particleCount;
+    gridCount = params.gridCount;
+    for (int material = 0; material <= MATERIAL_COUNT; material++)
+        materialStart[material] = params.materialStart[material];
+    particleRho = params.particleRho;
+    particleVol = params.particleVol;
+    particleMass = params.particleMass;
+    gravity = params.gravity;
+    bound = params.bound;
+    fluidBulkModulus = params.fluidBulkModulus;
+    elasticMu = params.elasticMu;
+    elasticLambda = params.elasticLambda;
+    snowMu = params.snowMu;
+    snowLambda = params.snowLambda;
+    snowCriticalCompression = params.snowCriticalCompression;
+    snowCriticalStretch = params.snowCriticalStretch;
+    snowHardening = params.snowHardening;
+    maxSnowHardening = params.maxSnowHardening;
+    if (gridCount < BLOCK_SIZE || materialStart[MATERIAL_COUNT] != particleCount)
+        throw std::runtime_error("Invalid MPM checkpoint parameters");
+    initGrid();
+
+    resizeParticleData();
+    readParticleArray(reader, "position", particles.position);
+    readParticleArray(reader, "velocity", particles.velocity);
+    const glm::mat2 *cData = reader.getArray<glm::mat2>("c", particleCount);
+    std::copy(cData, cData + particleCount, c.begin());
+    const float *jData = reader.getArray<float>("j", particleCount);
+    std::copy(jData, jData + particleCount, j.begin());
+    const Material *material = reader.getArray<Material>("material", particleCount);
+    std::copy(material, material + particleCount, materialData.begin());
+    const glm::mat2 *deformationData = reader.getArray<glm::mat2>("deformation", particleCount);
+    std::copy(deformationData, deformationData + particleCount, deformation.begin());
+    const float *plasticJData = reader.getArray<float>("plasticJ", particleCount);
+    std::copy(plasticJData, plasticJData + particleCount, plasticJ.begin());
+
+    size_t rngSize;
+    const char *rngText = static_cast<const char *>(reader.getSection("rng", rngSize));
+    std::istringstream(std::string(rngText, rngSize)) >> rng;
+}
+
+uint64_t MPM::getStateHash() const
+{
+    uint64_t hash = hashParticleArray(particles.position.x);
+    hash = hashParticleArray(particles.position.y, hash);
+    hash = hashParticleArray(particles.velocity.x, hash);
+    return hashParticleArray(particles.velocity.y, hash);
+}
+
+float MPM::getMaxParticleSpeed() const
+{
+    float maxSpeedSquared = 0.0f;
+#pragma omp parallel for reduction(max : maxSpeedSquared)
+    for (int p = 0; p < particleCount; p++)
     {
-        for (size_t j = 0; j < gridCount; j++)
+        glm::vec2 velocity = particles.velocity[p];
+        maxSpeedSquared = std::max(maxSpeedSquared, glm::dot(velocity, velocity));
+    }
+    return std::sqrt(maxSpeedSquared);
+}
+
+// sqrt(stiffness / density) with the p-wave modulus lambda + 2 mu of the solids
+float MPM::getWaveSpeed() const
+{
+    float stiffness = 0.0f;
+    if (getMaterialParticleCount(FLUID))
+        stiffness = std::max(stiffness, fluidBulkModulus);
+    if (getMaterialParticleCount(ELASTIC))
+        stiffness = std::max(stiffness, elasticLambda + 2.0f * elasticMu);
+    if (getMaterialParticleCount(SNOW))
+        stiffness = std::max(stiffness, (snowLambda + 2.0f * snowMu) * maxSnowHardening);
+    return std::sqrt(stiffness / particleRho);
+}
+
+/*
+ * Stress of every particle folded with its affine momentum into the matrix P2G scatters. Every
+ * material runs over its own particle range, so the loops have no per particle material branch.
+ */
+void MPM::computeStress(float deltaTime)
+{
+    float stressScale = -deltaTime * 4.0f * particleVol * gridCount * gridCount;
+    computeFluidStress(stressScale);
+    computeElasticStress(deltaTime, stressScale);
+    computeSnowStress(deltaTime, stressScale);
+}
+
+void MPM::computeFluidStress(float stressScale)
+{
+#pragma omp parallel for
+    for (int p = materialStart[FLUID]; p < materialStart[FLUID + 1]; p++)
+    {
+        float stress = stressScale * fluidBulkModulus * (j[p] - 1.0f);
+        affine[p] = glm::mat2(stress, 0.0f, 0.0f, stress) + particleMass * c[p];
+    }
+}
+
+void MPM::computeElasticStress(float deltaTime, float stressScale)
+{
+#pragma omp parallel for
+    for (int p = materialStart[ELASTIC]; p < materialStart[ELASTIC + 1]; p++)
+    {
+        glm::mat2 f = (glm::mat2(1.0f) + deltaTime * c[p]) * deformation[p];
+        deformation[p] = f;
+
+        glm::mat2 r = lve::math::polarRotation(f);
+        float volume = glm::determinant(f);
+        glm::mat2 stress = 2.0f * elasticMu * (f - r) * glm::transpose(f) +
+                           glm::mat2(elasticLambda * volume * (volume - 1.0f));
+        affine[p] = stressScale * stress + particleMass * c[p];
+    }
+}
+
+void MPM::computeSnowStress(float deltaTime, float stressScale)
+{
+    float maxHardening = 1.0f;
+#pragma omp parallel for reduction(max : maxHardening)
+    for (int p = materialStart[SNOW]; p < materialStart[SNOW + 1]; p++)
+    {
+        glm::mat2 f = (glm::mat2(1.0f) + deltaTime * c[p]) * deformation[p];
+
+        // clamp the singular values to the elastic range, the rest becomes plastic deformation
+        lve::math::Svd2 svd = lve::math::svd(f);
+        glm::vec2 sigma = glm::clamp(
+            svd.sigma,
+            glm::vec2(1.0f - snowCriticalCompression),
+            glm::vec2(1.0f + snowCriticalStretch));
+        plasticJ[p] *= (svd.sigma.x * svd.sigma.y) / (sigma.x * sigma.y);
+        f = svd.u * glm::mat2(sigma.x, 0.0f, 0.0f, sigma.y) * glm::transpose(svd.v);
+        deformation[p] = f;
+
+        float hardening = std::exp(snowHardening * (1.0f - plasticJ[p]));
+        maxHardening = std::max(maxHardening, hardening);
+        float mu = snowMu * hardening;
+        float lambda = snowLambda * hardening;
+        float volume = sigma.x * sigma.y;
+        glm::mat2 r = svd.u * glm::transpose(svd.v);
+        glm::mat2 stress = 2.0f * mu * (f - r) * glm::transpose(f) +
+                           glm::mat2(lambda * volume * (volume - 1.0f));
+        affine[p] = stressScale * stress + particleMass * c[p];
+    }
+    maxSnowHardening = maxHardening;
+}
+
+void MPM::scatterParticleToGrid(size_t p, float deltaTime)
+{
+    glm::vec2 gridPos = particles.position[p] / dx;
+    glm::ivec2 base = getBaseNode(gridPos);
+    glm::vec2 localPos = gridPos - glm::vec2(base);
+    std::array<glm::vec2, 3> w = {
+        0.5f * lve::math::square(1.5f - localPos),
+        0.75f - lve::math::square(localPos - 1.0f),
+        0.5f * lve::math::square(localPos - 0.5f)};
+    // most stencils stay inside one block, their nodes are then addressed without the block table
+    int baseX = base.x;
+    int baseY = base.y;
+    bool inBlock = (baseX & BLOCK_MASK) < BLOCK_SIZE - 2 && (baseY & BLOCK_MASK) < BLOCK_SIZE - 2;
+    glm::vec3 *baseNode = &getNode(baseX, baseY);
+    glm::mat2 particleAffine = affine[p];
+    for (size_t i = 0; i < 3; i++)
+    {
+        for (size_t j = 0; j < 3; j++)
         {
-            if (gridMass[i][j] > 0.0f)
-                gridVel[i][j] /= gridMass[i][j];
-
-            gridVel[i][j].y += gravity * deltaTime;
-
-            if (i < bound && gridVel[i][j].x < 0.0f)
-                gridVel[i][j].x = 0.0f;
-            else if (i > gridCount - bound && gridVel[i][j].x > 0.0f)
-                gridVel[i][j].x = 0.0f;
-            if (j < bound && gridVel[i][j].y < 0.0f)
-                gridVel[i][j].y = 0.0f;
-            else if (j > gridCount - bound && gridVel[i][j].y > 0.0f)
-                gridVel[i][j].y = 0.0f;
+            glm::vec2 offset = glm::vec2(i, j);
+            glm::vec2 dpos = (offset - localPos) * dx;
+            float weight = w[i].x * w[j].y;
+            glm::vec3 &node =
+                inBlock ? baseNode[(i << BLOCK_SHIFT) + j] : getNode(baseX + i, baseY + j);
+            glm::vec2 momentum =
+                weight * (particleMass * particles.velocity[p] + particleAffine * dpos);
+            node += glm::vec3(momentum, weight * particleMass);
         }
     }
-#pragma omp parallel for
-    // grid to particle
-    for (int p = 0; p < particleCount; p++)
+}
+
+void MPM::gatherParticleFromGrid(size_t p, float deltaTime)
+{
+    glm::vec2 gridPos = particles.position[p] / dx;
+    glm::ivec2 base = getBaseNode(gridPos);
+    glm::vec2 localPos = gridPos - glm::vec2(base);
+    std::array<glm::vec2, 3> w = {
+        0.5f * lve::math::square(1.5f - localPos),
+        0.75f - lve::math::square(localPos - 1.0f),
+        0.5f * lve::math::square(localPos - 0.5f)};
+    // most stencils stay inside one block, their nodes are then addressed without the block table
+    int baseX = base.x;
+    int baseY = base.y;
+    bool inBlock = (baseX & BLOCK_MASK) < BLOCK_SIZE - 2 && (baseY & BLOCK_MASK) < BLOCK_SIZE - 2;
+    glm::vec3 *baseNode = &getNode(baseX, baseY);
+    glm::vec2 newV = glm::vec2(0.0f, 0.0f);
+    glm::mat2 newC = glm::mat2(0.0f);
+    for (size_t i = 0; i < 3; i++)
     {
-        glm::vec2 gridPos = x[p] / dx;
-        glm::vec2 baseCoord = glm::floor(gridPos - glm::vec2(0.5f, 0.5f));
-        glm::vec2 localPos = gridPos - glm::vec2(baseCoord);
-        std::array<glm::vec2, 3> w = {
-            0.5f * lve::math::square(1.5f - localPos),
-            0.75f - lve::math::square(localPos - 1.0f),
-            0.5f * lve::math::square(localPos - 0.5f)};
-        glm::vec2 newV = glm::vec2(0.0f, 0.0f);
-        glm::mat2 newC = glm::mat2(0.0f);
-        for (size_t i = 0; i < 3; i++)
+        for (size_t j = 0; j < 3; j++)
         {
-            for (size_t j = 0; j < 3; j++)
-            {
-                glm::vec2 offset = glm::vec2(i, j);
-                glm::vec2 dpos = (offset - localPos) * dx;
-                float weight = w[i].x * w[j].y;
-                glm::vec2 gridVelValue = gridVel[baseCoord.x + i][baseCoord.y + j];
-                newV += weight * gridVelValue;
-                newC +=
-                    4.0f * weight * gridCount * gridCount * glm::outerProduct(gridVelValue, dpos);
-            }
+            glm::vec2 offset = glm::vec2(i, j);
+            glm::vec2 dpos = (offset - localPos) * dx;
+            float weight = w[i].x * w[j].y;
+            glm::vec2 gridVelValue = glm::vec2(
+                inBlock ? baseNode[(i << BLOCK_SHIFT) + j] : getNode(baseX + i, baseY + j));
+            newV += weight * gridVelValue;
+            newC += 4.0f * weight * gridCount * gridCount * glm::outerProduct(gridVelValue, dpos);
         }
-        v[p] = newV;
-        x[p] += deltaTime * v[p];
-        c[p] = newC;
-        j[p] *= 1.0f + deltaTime * lve::math::trace(c[p]);
     }
-    float dxMulBound = dx * bound;
+    particles.velocity.set(p, newV);
+    particles.position.set(p, particles.position[p] + deltaTime * newV);
+    c[p] = newC;
+    j[p] *= 1.0f + deltaTime * lve::math::trace(c[p]);
 }
-} // namespace app::fluidsim
\ No newline at end of file
+} // namespace app::fluidsim
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "particle_storage.hpp"
+
+// lve
+#include "lve/util/aligned_allocator.hpp"
+#include "lve/util/checkpoint.hpp"
+#include "lve/util/config.hpp"
+#include "lve/util/phase_timer.hpp"
+
 // libs
 #include "include/glm.hpp"
 
 // std
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
 #include <vector>
 
 namespace app::fluidsim
@@ -13,34 +25,216 @@ class MPM
 {
 public:
     MPM();
+    MPM(size_t particleCount); // overrides particleCount in config
+    MPM(size_t particleCount, size_t gridCount); // overrides particleCount and gridCount in config
     void substep(float deltaTime);
 
+    // materials, particles are stored grouped by material so every material runs its own
+    // branch free stress loop
+    enum Material
+    {
+        FLUID,   // weakly compressible, pressure from the volume change
+        ELASTIC, // fixed corotated
+        SNOW,    // fixed corotated with plasticity and hardening
+        MATERIAL_COUNT
+    };
+    static Material parseMaterial(const std::string &name);
+
+    // checkpoints hold the parameters and the full particle state, a loaded checkpoint continues
+    // bit exactly like the run that wrote it
+    static constexpr const char *CHECKPOINT_KIND = "mpm";
+    static constexpr uint32_t CHECKPOINT_VERSION = 1;
+    void writeCheckpoint(lve::CheckpointWriter &writer) const;
+    void readCheckpoint(const lve::CheckpointReader &reader); // replaces parameters and particles
+    uint64_t getStateHash() const; // of positions and velocities, to compare runs
+
 public: // getters
     size_t getParticleCount() const { return particleCount; }
-    const std::vector<glm::vec2> &getPositionData() const { return x; }
-    const std::vector<glm::vec2> &getVelocityData() const { return v; }
+    size_t getGridCount() const { return gridCount; }
+    float getCellSize() const { return dx; }
+    float getMaxParticleSpeed() const;
+    float getWaveSpeed() const; // fastest pressure wave of the materials in the scene
+    // the sparse grid is made of BLOCK_SIZE x BLOCK_SIZE node blocks, a gpu backend tiles its grid
+    // the same way
+    static constexpr int BLOCK_SHIFT = 3;
+    static constexpr int BLOCK_SIZE = 1 << BLOCK_SHIFT;
+    size_t getBlockCount() const { return blockCountPerSide * blockCountPerSide; }
+    size_t getActiveBlockCount() const { return activeBlocks.size(); }
+    const ParticleStorage &getParticles() const { return particles; }
+    const std::vector<Material> &getMaterialData() const { return materialData; }
+    size_t getMaterialParticleCount(Material material) const
+    {
+        return materialStart[material + 1] - materialStart[material];
+    }
 
-private: // structs
+    // parameters of the update rules, to run the same scene on another backend such as GpuMPM
+    struct SimParams
+    {
+        size_t gridCount;
+        size_t blockTableStride; // blocks per side of the block table, with a ring of padding
+        size_t elasticStart;     // first elastic particle
+        size_t snowStart;        // first snow particle
+        float dx;
+        int bound;
+        float particleMass;
+        float particleVol;
+        float gravity;
+        float fluidBulkModulus;
+        float elasticMu;
+        float elasticLambda;
+        float snowMu;
+        float snowLambda;
+        float snowCriticalCompression;
+        float snowCriticalStretch;
+        float snowHardening;
+    };
+    SimParams getSimParams() const;
+
+    // particle state besides positions and velocities, one entry per particle
+    const std::vector<glm::mat2> &getVelocityGradients() const { return c; }
+    const std::vector<float> &getVolumeChanges() const { return j; }
+    const std::vector<glm::mat2> &getDeformations() const { return deformation; }
+    const std::vector<float> &getPlasticVolumeChanges() const { return plasticJ; }
+    // replaces the state of every particle with the state computed by another backend, the arrays
+    // hold particleCount entries
+    void setParticleState(
+        const glm::vec2 *position,
+        const glm::vec2 *velocity,
+        const glm::mat2 *velocityGradient,
+        const float *volumeChange,
+        const glm::mat2 *deformationGradient,
+        const float *plasticVolumeChange);
+    // largest hardening factor of the last stress pass of another backend, see getWaveSpeed
+    void setMaxSnowHardening(float hardening) { maxSnowHardening = hardening; }
+
+public: // profiling
+    enum Phase
+    {
+        BINNING,
+        ACTIVATE_BLOCKS,
+        STRESS,
+        P2G,
+        GRID_UPDATE,
+        G2P,
+        PHASE_COUNT
+    };
+    const lve::PhaseTimer<PHASE_COUNT> &getPhaseTimer() const { return phaseTimer; }
+    void resetPhaseTimer() { phaseTimer.reset(); }
 
 private:
-    size_t particleCount = 4096;
-    size_t gridCount = 128;
-    float dx = 1.0f / gridCount;
+    size_t particleCount;
+    size_t gridCount;
+    float dx;
 
-    float particleRho = 1.0f;
-    float particleVol = dx * dx * 0.25f;
-    float particleMass = particleRho * particleVol;
+    float particleRho;
+    float particleVol;
+    float particleMass;
 
-    float gravity = 9.8f;
-    int bound = 3;
-    float E = 400.0f; // Young's modulus
+    float gravity;
+    int bound;
 
-    std::vector<glm::vec2> x; // position
-    std::vector<glm::vec2> v; // velocity
+    // material parameters, elastic and snow as Lame parameters
+    float fluidBulkModulus;
+    float elasticMu;
+    float elasticLambda;
+    float snowMu;
+    float snowLambda;
+    float snowCriticalCompression;
+    float snowCriticalStretch;
+    float snowHardening;
+    float maxSnowHardening = 1.0f; // largest hardening factor of the last stress pass
+
+    ParticleStorage particles;
     std::vector<glm::mat2> c; // deformation gradient velocity
     std::vector<float> j; // volume change (Jacobian)
+    std::vector<Material> materialData;
+    std::array<size_t, MATERIAL_COUNT + 1> materialStart{}; // first particle of every material
+    std::vector<glm::mat2> deformation; // deformation gradient of elastic and snow particles
+    std::vector<float> plasticJ; // volume change of the plastic deformation of snow particles
+    std::vector<glm::mat2> affine; // stress and affine momentum scattered by P2G
+
+    std::mt19937 rng; // seeded from config
+
+    // parameters section of a checkpoint
+    struct CheckpointParams
+    {
+        uint64_t particleCount;
+        uint64_t gridCount;
+        uint64_t materialStart[MATERIAL_COUNT + 1];
+        float particleRho;
+        float particleVol;
+        float particleMass;
+        float gravity;
+        int32_t bound;
+        float fluidBulkModulus;
+        float elasticMu;
+        float elasticLambda;
+        float snowMu;
+        float snowLambda;
+        float snowCriticalCompression;
+        float snowCriticalStretch;
+        float snowHardening;
+        float maxSnowHardening;
+    };
+
+    void initGrid();
+    void initSimParams(const lve::YamlConfig &config);
+    void resizeParticleData();
+    void initParticleData(const lve::YamlConfig &config);
+
+    void computeStress(float deltaTime);
+    void computeFluidStress(float stressScale);
+    void computeElasticStress(float deltaTime, float stressScale);
+    void computeSnowStress(float deltaTime, float stressScale);
+
+    /*
+     * Sparse grid of BLOCK_SIZE x BLOCK_SIZE node blocks, only blocks touched by a particle stencil
+     * are active and stored, so the cost of a substep follows the particles instead of the domain.
+     * The block table covers the domain plus a ring of one block on every side for the stencils
+     * of border particles and maps every block to its slot in blockPool or INVALID_SLOT. A node is
+     * a vec3 holding the momentum (velocity after the grid update) in xy and the mass in z, nodes
+     * of a block are contiguous and x major.
+     */
+    static constexpr int BLOCK_MASK = BLOCK_SIZE - 1;
+    static constexpr size_t BLOCK_NODE_COUNT = BLOCK_SIZE * BLOCK_SIZE;
+    static constexpr unsigned int INVALID_SLOT = ~0u;
+
+    size_t blockCountPerSide;
+    size_t blockTableStride;
+    std::vector<unsigned int> blockSlot;     // pool slot of each block table entry
+    std::vector<unsigned int> activeBlocks;  // block table index of each pool slot
+    std::vector<unsigned int> occupiedBlocks; // blocks holding the stencil base of a particle
+    std::vector<glm::vec3, lve::AlignedAllocator<glm::vec3, 64>> blockPool;
+
+    size_t getBlockTableIndex(int blockX, int blockY) const
+    {
+        return (blockX + 1) * blockTableStride + (blockY + 1);
+    }
+    // base node of the 3x3 stencil, clamped into the grid like getBaseNode of mpm_common.glsl, so
+    // the stencil of a stray particle stays inside the block table
+    glm::ivec2 getBaseNode(glm::vec2 gridPos) const
+    {
+        glm::ivec2 base = glm::ivec2(glm::floor(gridPos - glm::vec2(0.5f, 0.5f)));
+        return glm::clamp(base, glm::ivec2(0), glm::ivec2(static_cast<int>(gridCount) - 3));
+    }
+    glm::vec3 &getNode(int x, int y)
+    {
+        unsigned int slot = blockSlot[getBlockTableIndex(x >> BLOCK_SHIFT, y >> BLOCK_SHIFT)];
+        size_t node = ((x & BLOCK_MASK) << BLOCK_SHIFT) + (y & BLOCK_MASK);
+        return blockPool[slot * BLOCK_NODE_COUNT + node];
+    }
+    void activateBlock(size_t tableIndex);
+    void activateBlocks();
+
+    // particles binned by the block of their stencil base, so P2G can scatter blocks in parallel
+    // and G2P walks particles block by block, see binParticlesByBlock
+    std::vector<unsigned int> particleBlock;   // block table index of each particle
+    std::vector<unsigned int> blockStart;      // offset of each block in binnedParticles
+    std::vector<unsigned int> binnedParticles; // particle indices ordered by block
+    void binParticlesByBlock();
+    void scatterParticleToGrid(size_t p, float deltaTime);
+    void gatherParticleFromGrid(size_t p, float deltaTime);
 
-    std::vector<std::vector<glm::vec2>> gridVel;
-    std::vector<std::vector<float>> gridMass;
+    lve::PhaseTimer<PHASE_COUNT> phaseTimer;
 };
 } // namespace app::fluidsim
\ No newline at end of file
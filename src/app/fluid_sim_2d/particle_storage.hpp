@@ -0,0 +1,145 @@
+#pragma once
+
+// lve
+#include "lve/util/aligned_allocator.hpp"
+#include "lve/util/checkpoint.hpp"
+#include "lve/util/hash.hpp"
+
+// libs
+#include "include/glm.hpp"
+
+// std
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace app::fluidsim
+{
+/*
+ * One float per particle, aligned to a cache line and zero padded to a multiple of the widest simd
+ * width, so simd loops can run full aligned batches up to paddedSize() without a scalar tail.
+ */
+class ParticleFloatArray
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+    static constexpr size_t SIMD_PADDING = 16; // floats in an AVX-512 register
+
+    static size_t getPaddedSize(size_t count)
+    {
+        return (count + SIMD_PADDING - 1) / SIMD_PADDING * SIMD_PADDING;
+    }
+
+    void resize(size_t count)
+    {
+        size = count;
+        data.resize(getPaddedSize(count));
+        std::fill(data.begin() + count, data.end(), 0.f);
+    }
+    void swap(ParticleFloatArray &other)
+    {
+        std::swap(size, other.size);
+        data.swap(other.data);
+    }
+
+    size_t getSize() const { return size; }
+    size_t getPaddedSize() const { return data.size(); }
+    size_t getCapacityBytes() const { return data.capacity() * sizeof(float); }
+    float *getData() { return data.data(); }
+    const float *getData() const { return data.data(); }
+    float &operator[](size_t index) { return data[index]; }
+    const float &operator[](size_t index) const { return data[index]; }
+
+private:
+    size_t size = 0;
+    std::vector<float, lve::AlignedAllocator<float, ALIGNMENT>> data;
+};
+
+// 2d vector per particle split into separate x and y arrays
+struct ParticleVec2Array
+{
+    ParticleFloatArray x;
+    ParticleFloatArray y;
+
+    void resize(size_t count)
+    {
+        x.resize(count);
+        y.resize(count);
+    }
+    void swap(ParticleVec2Array &other)
+    {
+        x.swap(other.x);
+        y.swap(other.y);
+    }
+
+    size_t getSize() const { return x.getSize(); }
+    size_t getCapacityBytes() const { return x.getCapacityBytes() + y.getCapacityBytes(); }
+    glm::vec2 operator[](size_t index) const { return {x[index], y[index]}; }
+    void set(size_t index, glm::vec2 value)
+    {
+        x[index] = value.x;
+        y[index] = value.y;
+    }
+};
+
+// particle state shared by the solvers and the renderers
+struct ParticleStorage
+{
+    ParticleVec2Array position;
+    ParticleVec2Array velocity;
+
+    void resize(size_t count)
+    {
+        position.resize(count);
+        velocity.resize(count);
+    }
+    size_t getSize() const { return position.getSize(); }
+};
+
+// checkpoint sections of particle arrays, without the simd padding
+inline void writeParticleArray(
+    lve::CheckpointWriter &writer, const std::string &name, const ParticleFloatArray &array)
+{
+    writer.addSection(name, array.getData(), array.getSize() * sizeof(float));
+}
+inline void writeParticleArray(
+    lve::CheckpointWriter &writer, const std::string &name, const ParticleVec2Array &array)
+{
+    writeParticleArray(writer, name + ".x", array.x);
+    writeParticleArray(writer, name + ".y", array.y);
+}
+// the array has to be resized to the particle count of the checkpoint
+inline void readParticleArray(
+    const lve::CheckpointReader &reader, const std::string &name, ParticleFloatArray &array)
+{
+    const float *data = reader.getArray<float>(name, array.getSize());
+    std::copy(data, data + array.getSize(), array.getData());
+}
+inline void readParticleArray(
+    const lve::CheckpointReader &reader, const std::string &name, ParticleVec2Array &array)
+{
+    readParticleArray(reader, name + ".x", array.x);
+    readParticleArray(reader, name + ".y", array.y);
+}
+inline uint64_t hashParticleArray(
+    const ParticleFloatArray &array, uint64_t seed = lve::HASH_BYTES_SEED)
+{
+    return lve::hashBytes(array.getData(), array.getSize() * sizeof(float), seed);
+}
+
+// particle state published by the simulation thread for the renderer
+struct ParticleSnapshot
+{
+    ParticleStorage particles;
+    int substepCount = 0; // substeps of the simulation tick that produced it
+};
+
+// particle sorted into a spacial cell, 32 bit fields keep the entry at 8 bytes
+struct SpatialHashEntry
+{
+    uint32_t particleIndex;
+    uint32_t spatialHashKey;
+};
+} // namespace app::fluidsim
@@ -0,0 +1,49 @@
+#pragma once
+
+// lve
+#include "lve/util/checkpoint.hpp"
+
+// libs
+#include "include/glm.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace app::fluidsim
+{
+// input of one simulation step, applied before stepping the solver
+struct ReplayStep
+{
+    float deltaTime;
+    uint32_t rangeForceActive;
+    uint32_t rangeForceRepulsive;
+    glm::vec2 rangeForcePosition; // mouse position as passed to SPH::setRangeForcePos
+};
+
+/*
+ * Input stream of a run, stored next to the checkpoint of its initial state in the same file.
+ * Loading the checkpoint and applying the steps in order reproduces the run bit exactly on the
+ * same build and simd level, finalHash is the state hash after the last step to verify that.
+ */
+struct ReplayRecording
+{
+    std::vector<ReplayStep> steps;
+    uint64_t finalHash = 0;
+
+    void write(lve::CheckpointWriter &writer) const
+    {
+        writer.addArray("replay.steps", steps);
+        writer.addValue("replay.finalHash", finalHash);
+    }
+    static ReplayRecording read(const lve::CheckpointReader &reader)
+    {
+        ReplayRecording recording;
+        size_t stepCount = reader.getArraySize<ReplayStep>("replay.steps");
+        const ReplayStep *steps = reader.getArray<ReplayStep>("replay.steps", stepCount);
+        recording.steps.assign(steps, steps + stepCount);
+        recording.finalHash = reader.getValue<uint64_t>("replay.finalHash");
+        return recording;
+    }
+};
+} // namespace app::fluidsim
@@ -6,16 +6,31 @@
 #include "lve/util/file_io.hpp"
 #include "lve/util/math.hpp"
 
+// libs
+#include <omp.h>
+
 // std
 #include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace app::fluidsim
 {
-SPH::SPH(VkExtent2D windowExtent) : windowExtent(windowExtent)
+SPH::SPH(VkExtent2D windowExtent)
+    : SPH(windowExtent,
+          lve::ConfigManager::getConfig(lve::path::config::FLUID_SIM_2D)
+              .get<size_t>("particleCount"))
+{
+}
+
+SPH::SPH(VkExtent2D windowExtent, size_t particleCount)
+    : particleCount(particleCount), windowExtent(windowExtent)
 {
     const lve::YamlConfig config = lve::ConfigManager::getConfig(lve::path::config::FLUID_SIM_2D);
-    particleCount = config.get<size_t>("particleCount");
 
     initSimParams();
 
@@ -23,6 +38,7 @@ SPH::SPH(VkExtent2D windowExtent) : windowExtent(windowExtent)
     float stride = config.get<float>("stride");
     float maxWidth = config.get<float>("maxWidth");
     bool randomize = config.get<bool>("randomize");
+    rng.seed(config.get<uint32_t>("seed"));
 
     initParticleData(glm::vec2(startPoint[0], startPoint[1]), stride, maxWidth, randomize);
 }
@@ -33,17 +49,17 @@ void SPH::reloadConfigParam()
     initSimParams();
 }
 
-void SPH::initParticleData(
-    glm::vec2 startPoint, float stride, float maxWidth, bool randomize)
+void SPH::resizeParticleData()
 {
-    positionData.resize(particleCount);
+    particles.resize(particleCount);
     nextPositionData.resize(particleCount);
-    velocityData.resize(particleCount);
     densityData.resize(particleCount);
     massData.resize(particleCount);
+    particleIdData.resize(particleCount);
+    particleIndexData.resize(particleCount);
 
     spacialLookup.resize(particleCount);
-    spacialLookupEntry.resize(particleCount);
+    spacialHashKeyData.resize(particleCount);
 
     // debug
     pressureForceData.resize(particleCount);
@@ -56,26 +72,38 @@ void SPH::initParticleData(
         debugLines[i].start.color = glm::vec4(1.f, 0.f, 0.f, 1.f);
         debugLines[i].end.color = glm::vec4(0.f, 1.f, 0.f, 1.f);
     }
+}
+
+void SPH::initParticleData(
+    glm::vec2 startPoint, float stride, float maxWidth, bool randomize)
+{
+    resizeParticleData();
 
     // init particle data
     int cntPerRow = static_cast<int>(maxWidth / stride);
     maxWidth -= std::fmod(maxWidth, stride);
     int row, col;
+    std::uniform_real_distribution<float> randomX(0.f, scaledWindowExtent.x);
+    std::uniform_real_distribution<float> randomY(0.f, scaledWindowExtent.y);
     for (int i = 0; i < particleCount; i++)
     {
         row = static_cast<int>(i / cntPerRow);
         col = i % cntPerRow;
 
         if (randomize)
-            positionData[i] = glm::vec2(
-                static_cast<float>(rand()) / static_cast<float>(RAND_MAX / scaledWindowExtent.x),
-                static_cast<float>(rand()) / static_cast<float>(RAND_MAX / scaledWindowExtent.y));
+        {
+            float positionX = randomX(rng);
+            particles.position.set(i, glm::vec2(positionX, randomY(rng)));
+        }
         else
-            positionData[i] = startPoint + glm::vec2(col * stride, row * stride);
+            particles.position.set(i, startPoint + glm::vec2(col * stride, row * stride));
 
-        velocityData[i] = glm::vec2(0.f, 0.f);
+        particles.velocity.set(i, glm::vec2(0.f, 0.f));
 
         massData[i] = 1.f;
+
+        particleIdData[i] = i;
+        particleIndexData[i] = i;
     }
 }
 
@@ -93,7 +121,23 @@ void SPH::initSimParams()
     dataScale = config.get<float>("dataScale");
     rangeForceScale = config.get<float>("rangeForceScale");
     rangeForceRadius = config.get<float>("rangeForceRadius");
+    maxDeltaTime = config.get<float>("maxDeltaTime");
+    reorderInterval = config.get<int>("reorderInterval");
+    initDerivedParams();
 
+    std::string neighborSearchName = config.get<std::string>("neighborSearch");
+    if (neighborSearchName == "hashed")
+        neighborSearch = HASHED;
+    else if (neighborSearchName == "dense")
+        neighborSearch = DENSE;
+    else
+        throw std::runtime_error("Unknown neighborSearch: " + neighborSearchName);
+    setNeighborListMode(config.get<bool>("neighborList"), config.get<float>("neighborListSkin"));
+}
+
+// values computed from the simulation parameters
+void SPH::initDerivedParams()
+{
     scaledWindowExtent.x = static_cast<float>(windowExtent.width) * dataScale;
     scaledWindowExtent.y = static_cast<float>(windowExtent.height) * dataScale;
 
@@ -116,6 +160,7 @@ void SPH::updateWindowExtent(VkExtent2D newExtent)
     windowExtent = newExtent;
     scaledWindowExtent.x = static_cast<float>(windowExtent.width) * dataScale;
     scaledWindowExtent.y = static_cast<float>(windowExtent.height) * dataScale;
+    updateSpacialGrid();
 }
 
 void SPH::updateParticleData(float deltaTime)
@@ -132,56 +177,83 @@ void SPH::updateParticleData(float deltaTime)
     if (deltaTime > maxDeltaTime)
         deltaTime = maxDeltaTime;
 
-    for (int i = 0; i < particleCount; i++) // update predicted position and spacial lookup
+    neighborScratch.resize(omp_get_max_threads());
+    phaseTimer.start();
+
+#pragma omp parallel for
+    for (int i = 0; i < particleCount; i++) // update predicted position
     {
-        nextPositionData[i] = positionData[i] + velocityData[i] * lookAheadTime;
-        int hashValue = hashGridCoord2D(pos2gridCoord(nextPositionData[i], smoothRadius));
-        unsigned int hashKey = lve::math::positiveMod(hashValue, particleCount);
-        spacialLookup[i].particleIndex = i;
-        spacialLookup[i].spatialHashKey = hashKey;
+        nextPositionData.x[i] = particles.position.x[i] + particles.velocity.x[i] * lookAheadTime;
+        nextPositionData.y[i] = particles.position.y[i] + particles.velocity.y[i] * lookAheadTime;
     }
+    // a neighbor list within its skin is still complete, the lookup and order are kept with it,
+    // so the keys that only feed the lookup are not computed either
+    bool rebuildSpacialLookup = !useNeighborList || isNeighborListOutdated();
+    if (rebuildSpacialLookup)
+    {
+#pragma omp parallel for
+        for (int i = 0; i < particleCount; i++) // update spacial hash key
+            spacialHashKeyData[i] = getSpacialKey(getSpacialCell(nextPositionData[i]));
+    }
+    phaseTimer.lap(HASHING);
 
-    std::sort(
-        spacialLookup.begin(),
-        spacialLookup.end(),
-        [](const SpatialHashEntry &a, const SpatialHashEntry &b) {
-            return a.spatialHashKey < b.spatialHashKey;
-        });
+    if (rebuildSpacialLookup)
+    {
+        buildSpacialLookup();
+        if (reorderInterval > 0 && stepsUntilReorder <= 0)
+        {
+            reorderParticleData();
+            stepsUntilReorder = reorderInterval;
+        }
+    }
+    if (stepsUntilReorder > 0)
+        stepsUntilReorder--;
+    stepCount++;
+    phaseTimer.lap(SORT);
 
-    // init spacial lookup entry
-    std::fill(spacialLookupEntry.begin(), spacialLookupEntry.end(), -1);
-    for (int i = 0; i < particleCount; i++)
+    if (useNeighborList)
     {
-        unsigned int key = spacialLookup[i].spatialHashKey;
-        unsigned int keyPrev = (i == 0) ? -1 : spacialLookup[i - 1].spatialHashKey;
-        if (key != keyPrev)
-            spacialLookupEntry[key] = i;
+        if (rebuildSpacialLookup)
+            buildNeighborList();
+        refreshNeighborList();
     }
+    phaseTimer.lap(NEIGHBOR_LIST);
 
     if (isNeighborViewActive)
     {
         // store neighbor index of the first particle
         firstParticleNeighborIndex.clear();
-        foreachNeighbor(0, [&](int neighborIndex) {
-            firstParticleNeighborIndex.push_back(neighborIndex);
-        });
+        foreachNeighborInRange(
+            getFirstParticleIndex(), [&](size_t neighborIndex, float, glm::vec2) {
+                firstParticleNeighborIndex.push_back(static_cast<int>(neighborIndex));
+            });
     }
 
+#pragma omp parallel for
     for (int i = 0; i < particleCount; i++) // calculate density using predicted position
         densityData[i] = calculateDensity(i);
+    phaseTimer.lap(DENSITY);
 
-    for (int i = 0; i < particleCount; i++) // update velocity and position
+#pragma omp parallel for
+    for (int i = 0; i < particleCount; i++) // calculate forces using velocity of last step
     {
         pressureForceData[i] = calculatePressureForce(i);
         externalForceData[i] = calculateExternalForce(i);
         viscosityForceData[i] = calculateViscosityForce(i);
+    }
+    phaseTimer.lap(FORCES);
 
+#pragma omp parallel for
+    for (int i = 0; i < particleCount; i++) // update velocity and position
+    {
         glm::vec2 acceleration =
             (pressureForceData[i] + viscosityForceData[i] + externalForceData[i]) /
             densityData[i].density;
-        velocityData[i] += acceleration * deltaTime;
-        positionData[i] += velocityData[i] * deltaTime;
+        glm::vec2 velocity = particles.velocity[i] + acceleration * deltaTime;
+        particles.velocity.set(i, velocity);
+        particles.position.set(i, particles.position[i] + velocity * deltaTime);
     }
+    phaseTimer.lap(INTEGRATION);
 
     rangeForceInfo.active = false;
 
@@ -192,10 +264,10 @@ void SPH::updateParticleData(float deltaTime)
 
 void SPH::updateDebugLines()
 {
-    auto setDebugLines = [&](std::function<glm::vec2(int)> callback) {
+    auto setDebugLines = [&](auto &&callback) {
         for (int i = 0; i < particleCount; i++)
         {
-            glm::vec2 particlePos = positionData[i];
+            glm::vec2 particlePos = particles.position[i];
             debugLines[i].start.position = glm::vec3(scaledPos2ScreenPos(particlePos), debugLineZ);
             debugLines[i].end.position =
                 glm::vec3(scaledPos2ScreenPos(particlePos + callback(i)), debugLineZ);
@@ -204,7 +276,7 @@ void SPH::updateDebugLines()
 
     if (debugLineType == VELOCITY)
         setDebugLines([&](int i) {
-            return velocityData[i] * 0.1f;
+            return particles.velocity[i] * 0.1f;
         });
     else if (debugLineType == PRESSURE_FORCE)
         setDebugLines([&](int i) {
@@ -224,6 +296,207 @@ void SPH::setRangeForcePos(bool isRepulsive, glm::vec2 mousePosition)
     rangeForceInfo.position = mousePosition * dataScale;
 }
 
+SPH::SimParams SPH::getSimParams() const
+{
+    return {
+        smoothRadius,
+        boundaryMultipler,
+        targetDensity,
+        pressureMultiplier,
+        nearPressureMultiplier,
+        viscosityMultiplier,
+        gravityAccValue,
+        dataScale,
+        rangeForceScale,
+        rangeForceRadius,
+        lookAheadTime,
+        maxDeltaTime,
+        boundaryMargin,
+        scaledWindowExtent,
+        scalingFactorPoly6_2D,
+        scalingFactorSpikyPow3_2D,
+        scalingFactorSpikyPow2_2D};
+}
+
+void SPH::writeCheckpoint(lve::CheckpointWriter &writer) const
+{
+    CheckpointParams params{};
+    params.particleCount = particleCount;
+    params.stepCount = stepCount;
+    params.windowWidth = windowExtent.width;
+    params.windowHeight = windowExtent.height;
+    params.smoothRadius = smoothRadius;
+    params.boundaryMultipler = boundaryMultipler;
+    params.targetDensity = targetDensity;
+    params.pressureMultiplier = pressureMultiplier;
+    params.nearPressureMultiplier = nearPressureMultiplier;
+    params.viscosityMultiplier = viscosityMultiplier;
+    params.gravityAccValue = gravityAccValue;
+    params.dataScale = dataScale;
+    params.rangeForceScale = rangeForceScale;
+    params.rangeForceRadius = rangeForceRadius;
+    params.reorderInterval = reorderInterval;
+    params.stepsUntilReorder = stepsUntilReorder;
+    params.neighborSearch = neighborSearch;
+    params.useNeighborList = useNeighborList;
+    params.neighborListSkin = neighborListSkin;
+    params.neighborListOutdated = neighborListOutdated;
+    params.simdLevel = kernelBatch->simdLevel;
+    writer.addValue("params", params);
+
+    writeParticleArray(writer, "position", particles.position);
+    writeParticleArray(writer, "velocity", particles.velocity);
+    writeParticleArray(writer, "mass", massData);
+    writer.addArray("density", densityData);
+    writer.addArray("particleId", particleIdData);
+    writer.addArray("particleIndex", particleIndexData);
+
+    // a list within its skin is reused by the next step, it has to survive for an exact replay
+    if (useNeighborList)
+    {
+        writer.addArray("neighborList.start", neighborListStart);
+        writer.addArray("neighborList.index", neighborListIndex);
+        writer.addArray("neighborList.buildPos", neighborListBuildPosition);
+    }
+
+    std::ostringstream rngState;
+    rngState << rng;
+    std::string rngText = rngState.str();
+    writer.addSection("rng", rngText.data(), rngText.size());
+}
+
+void SPH::readCheckpoint(const lve::CheckpointReader &reader)
+{
+    reader.checkKind(CHECKPOINT_KIND, CHECKPOINT_VERSION);
+    CheckpointParams params = reader.getValue<CheckpointParams>("params");
+
+    particleCount = params.particleCount;
+    stepCount = params.stepCount;
+    windowExtent = {params.windowWidth, params.windowHeight};
+    smoothRadius = params.smoothRadius;
+    boundaryMultipler = params.boundaryMultipler;
+    targetDensity = params.targetDensity;
+    pressureMultiplier = params.pressureMultiplier;
+    nearPressureMultiplier = params.nearPressureMultiplier;
+    viscosityMultiplier = params.viscosityMultiplier;
+    gravityAccValue = params.gravityAccValue;
+    dataScale = params.dataScale;
+    rangeForceScale = params.rangeForceScale;
+    rangeForceRadius = params.rangeForceRadius;
+    reorderInterval = params.reorderInterval;
+    stepsUntilReorder = params.stepsUntilReorder;
+    initDerivedParams();
+    neighborSearch = static_cast<NeighborSearch>(params.neighborSearch);
+    setNeighborListMode(params.useNeighborList != 0, params.neighborListSkin);
+
+    resizeParticleData();
+    readParticleArray(reader, "position", particles.position);
+    readParticleArray(reader, "velocity", particles.velocity);
+    readParticleArray(reader, "mass", massData);
+    const Density *density = reader.getArray<Density>("density", particleCount);
+    std::copy(density, density + particleCount, densityData.begin());
+    const unsigned int *particleId = reader.getArray<unsigned int>("particleId", particleCount);
+    std::copy(particleId, particleId + particleCount, particleIdData.begin());
+    const unsigned int *particleIndex =
+        reader.getArray<unsigned int>("particleIndex", particleCount);
+    std::copy(particleIndex, particleIndex + particleCount, particleIndexData.begin());
+
+    if (useNeighborList)
+    {
+        const unsigned int *start =
+            reader.getArray<unsigned int>("neighborList.start", particleCount + 1);
+        std::copy(start, start + particleCount + 1, neighborListStart.begin());
+        size_t entryCount = neighborListStart[particleCount];
+        const unsigned int *index =
+            reader.getArray<unsigned int>("neighborList.index", entryCount);
+        neighborListIndex.assign(index, index + entryCount);
+        neighborListDistance.resize(entryCount);
+        neighborListDirection.resize(entryCount);
+        const glm::vec2 *buildPosition =
+            reader.getArray<glm::vec2>("neighborList.buildPos", particleCount);
+        std::copy(buildPosition, buildPosition + particleCount, neighborListBuildPosition.begin());
+        neighborListOutdated = params.neighborListOutdated != 0;
+    }
+
+    size_t rngSize;
+    const char *rngText = static_cast<const char *>(reader.getSection("rng", rngSize));
+    std::istringstream(std::string(rngText, rngSize)) >> rng;
+
+    // kernels of another simd level round differently, keep the current ones if not supported
+    lve::cpu::SimdLevel simdLevel = static_cast<lve::cpu::SimdLevel>(params.simdLevel);
+    if (simdLevel <= lve::cpu::getSimdLevel())
+        kernelBatch = &getSphKernelBatch(simdLevel);
+}
+
+uint64_t SPH::getStateHash() const
+{
+    uint64_t hash = hashParticleArray(particles.position.x);
+    hash = hashParticleArray(particles.position.y, hash);
+    hash = hashParticleArray(particles.velocity.x, hash);
+    return hashParticleArray(particles.velocity.y, hash);
+}
+
+/*
+ * Switch between traversing the spacial lookup in every pass and a neighbor list built once and
+ * shared by the density and force passes. With a positive skin the list also holds particles up
+ * to smoothRadius + skin apart and is only rebuilt after some particle moved more than skin / 2.
+ */
+void SPH::setNeighborListMode(bool enabled, float skin)
+{
+    useNeighborList = enabled;
+    neighborListSkin = enabled ? std::max(skin, 0.f) : 0.f;
+    searchRadius = smoothRadius + neighborListSkin;
+    neighborListOutdated = true;
+    updateSpacialGrid();
+
+    if (enabled)
+    {
+        neighborListStart.resize(particleCount + 1);
+        neighborListBuildPosition.resize(particleCount);
+    }
+    else
+    {
+        std::vector<unsigned int>().swap(neighborListStart);
+        std::vector<unsigned int>().swap(neighborListIndex);
+        std::vector<float>().swap(neighborListDistance);
+        std::vector<glm::vec2>().swap(neighborListDirection);
+        std::vector<glm::vec2>().swap(neighborListBuildPosition);
+        std::vector<std::vector<unsigned int>>().swap(neighborListThreadBuffer);
+    }
+}
+
+float SPH::getMaxParticleSpeed() const
+{
+    float maxSpeedSquared = 0.f;
+#pragma omp parallel for reduction(max : maxSpeedSquared)
+    for (int i = 0; i < particleCount; i++)
+    {
+        glm::vec2 velocity = particles.velocity[i];
+        maxSpeedSquared = std::max(maxSpeedSquared, glm::dot(velocity, velocity));
+    }
+    return std::sqrt(maxSpeedSquared);
+}
+
+size_t SPH::getNeighborListMemoryUsage() const
+{
+    size_t threadBufferSize = 0;
+    for (const std::vector<unsigned int> &buffer : neighborListThreadBuffer)
+        threadBufferSize += buffer.capacity() * sizeof(unsigned int);
+    return neighborListStart.capacity() * sizeof(unsigned int) +
+        neighborListIndex.capacity() * sizeof(unsigned int) +
+        neighborListDistance.capacity() * sizeof(float) +
+        neighborListDirection.capacity() * sizeof(glm::vec2) +
+        neighborListBuildPosition.capacity() * sizeof(glm::vec2) + threadBufferSize;
+}
+
+size_t SPH::getSpacialLookupMemoryUsage() const
+{
+    return spacialLookup.capacity() * sizeof(SpatialHashEntry) +
+        spacialLookupEntry.capacity() * sizeof(int) +
+        spacialHashKeyData.capacity() * sizeof(unsigned int) +
+        spacialLookupCursor.capacity() * sizeof(unsigned int);
+}
+
 float SPH::kernelPoly6_2D(float distance, float radius) const
 {
     if (distance >= radius)
@@ -266,50 +539,76 @@ float SPH::derivativeSpikyPow2_2D(float distance, float radius) const
 
 SPH::Density SPH::calculateDensity(size_t particleIndex)
 {
+    NeighborScratch &scratch = neighborScratch[omp_get_thread_num()];
+    NeighborRange neighbors = gatherNeighbors(particleIndex, scratch);
+    float *spikyPow2 = scratch.kernelValue[0].data();
+    float *spikyPow3 = scratch.kernelValue[1].data();
+    kernelBatch->spikyPow2(
+        neighbors.distance, spikyPow2, neighbors.count, smoothRadius, scalingFactorSpikyPow2_2D);
+    kernelBatch->spikyPow3(
+        neighbors.distance, spikyPow3, neighbors.count, smoothRadius, scalingFactorSpikyPow3_2D);
+
     float density = massData[particleIndex] * scalingFactorSpikyPow2_2D_atZero;
     float nearDensity = massData[particleIndex] * scalingFactorSpikyPow3_2D_atZero;
-    glm::vec2 particleNextPos = nextPositionData[particleIndex];
-    foreachNeighbor(particleIndex, [&](int neighborIndex) {
-        float distance = glm::distance(particleNextPos, nextPositionData[neighborIndex]);
-        if (distance >= smoothRadius)
-            return;
-        density += massData[neighborIndex] * kernelSpikyPow2_2D(distance, smoothRadius);
-        nearDensity += massData[neighborIndex] * kernelSpikyPow3_2D(distance, smoothRadius);
-    });
+    for (size_t k = 0; k < neighbors.count; k++)
+    {
+        float mass = massData[neighbors.index[k]];
+        density += mass * spikyPow2[k];
+        nearDensity += mass * spikyPow3[k];
+    }
     return {density, nearDensity};
 }
 
 glm::vec2 SPH::calculatePressureForce(size_t particleIndex)
 {
+    NeighborScratch &scratch = neighborScratch[omp_get_thread_num()];
+    NeighborRange neighbors = gatherNeighbors(particleIndex, scratch);
+    float *derivativePow2 = scratch.kernelValue[0].data();
+    float *derivativePow3 = scratch.kernelValue[1].data();
+    kernelBatch->derivativeSpikyPow2(
+        neighbors.distance,
+        derivativePow2,
+        neighbors.count,
+        smoothRadius,
+        scalingFactorSpikyPow2_2D);
+    kernelBatch->derivativeSpikyPow3(
+        neighbors.distance,
+        derivativePow3,
+        neighbors.count,
+        smoothRadius,
+        scalingFactorSpikyPow3_2D);
+
     glm::vec2 pressureForce = glm::vec2(0.f, 0.f);
-    glm::vec2 particleNextPos = nextPositionData[particleIndex];
     float pressureThis = pressureMultiplier * (densityData[particleIndex].density - targetDensity);
     float nearPressureThis = nearPressureMultiplier * densityData[particleIndex].nearDensity;
-
-    foreachNeighbor(particleIndex, [&](int neighborIndex) {
-        float distance = glm::distance(particleNextPos, nextPositionData[neighborIndex]);
-        if (distance >= smoothRadius)
-            return;
-
-        glm::vec2 dir;
-        if (distance < glm::epsilon<float>())
-            dir = glm::circularRand(1.f);
-        else
-            dir = glm::normalize(nextPositionData[neighborIndex] - particleNextPos);
-
-        float pressureOther =
-            pressureMultiplier * (densityData[neighborIndex].density - targetDensity);
-        float nearPressureOther = nearPressureMultiplier * densityData[neighborIndex].nearDensity;
+    for (size_t k = 0; k < neighbors.count; k++)
+    {
+        const Density &densityOther = densityData[neighbors.index[k]];
+        float pressureOther = pressureMultiplier * (densityOther.density - targetDensity);
+        float nearPressureOther = nearPressureMultiplier * densityOther.nearDensity;
         float sharedPressure = (pressureThis + pressureOther) * 0.5f;
         float sharedNearPressure = (nearPressureThis + nearPressureOther) * 0.5f;
-        pressureForce += derivativeSpikyPow2_2D(distance, smoothRadius) /
-            densityData[neighborIndex].density * sharedPressure * dir;
-        pressureForce += derivativeSpikyPow3_2D(distance, smoothRadius) /
-            densityData[neighborIndex].nearDensity * sharedNearPressure * dir;
-    });
+        glm::vec2 dir = neighbors.direction[k];
+        pressureForce += derivativePow2[k] / densityOther.density * sharedPressure * dir;
+        pressureForce += derivativePow3[k] / densityOther.nearDensity * sharedNearPressure * dir;
+    }
     return pressureForce;
 }
 
+/*
+ * Direction used between two particles at the same position. Derived from the particle ids and
+ * the step count instead of a shared random generator, so the result does not depend on the
+ * order in which particles are evaluated or on the number of threads.
+ */
+glm::vec2 SPH::getCoincidentDirection(size_t particleIndex, size_t neighborIndex) const
+{
+    uint32_t hash = lve::math::hashUint32(static_cast<uint32_t>(stepCount));
+    hash = lve::math::hashUint32(hash ^ particleIdData[particleIndex]);
+    hash = lve::math::hashUint32(hash ^ particleIdData[neighborIndex]);
+    float angle = static_cast<float>(hash) * (2.f * static_cast<float>(M_PI) / 4294967296.f);
+    return glm::vec2(std::cos(angle), std::sin(angle));
+}
+
 glm::vec2 SPH::calculateExternalForce(size_t particleIndex)
 {
     glm::vec2 externalForce = glm::vec2(0.f, 0.f);
@@ -335,7 +634,7 @@ glm::vec2 SPH::calculateExternalForce(size_t particleIndex)
 
         // slow down the velocity when particles are out of boundary
         externalForce +=
-            boundaryMultipler * (boundaryForce - velocityData[particleIndex] * dataScale);
+            boundaryMultipler * (boundaryForce - particles.velocity[particleIndex] * dataScale);
     }
 
     // gravity
@@ -345,7 +644,7 @@ glm::vec2 SPH::calculateExternalForce(size_t particleIndex)
     // range force
     if (rangeForceInfo.active)
     {
-        glm::vec2 particlePos = positionData[particleIndex];
+        glm::vec2 particlePos = particles.position[particleIndex];
         float distance = glm::distance(particlePos, rangeForceInfo.position);
         if (distance < rangeForceRadius && distance > glm::epsilon<float>())
         {
@@ -371,7 +670,7 @@ glm::vec2 SPH::calculateExternalForce(size_t particleIndex)
 
                 // slow down the velocity when particles are in the range
                 externalForce -= rangeForceScale * viscosityMultiplier * (1 - distOverRadius) *
-                    densityData[particleIndex].density * velocityData[particleIndex];
+                    densityData[particleIndex].density * particles.velocity[particleIndex];
             }
         }
     }
@@ -381,17 +680,263 @@ glm::vec2 SPH::calculateExternalForce(size_t particleIndex)
 
 glm::vec2 SPH::calculateViscosityForce(size_t particleIndex)
 {
+    NeighborScratch &scratch = neighborScratch[omp_get_thread_num()];
+    NeighborRange neighbors = gatherNeighbors(particleIndex, scratch);
+    float *poly6 = scratch.kernelValue[0].data();
+    kernelBatch->poly6(
+        neighbors.distance, poly6, neighbors.count, smoothRadius, scalingFactorPoly6_2D);
+
     glm::vec2 viscosityForce = glm::vec2(0.f, 0.f);
-    glm::vec2 particleNextPos = nextPositionData[particleIndex];
-    foreachNeighbor(particleIndex, [&](int neighborIndex) {
-        float distance = glm::distance(particleNextPos, nextPositionData[neighborIndex]);
-        if (distance >= smoothRadius)
-            return;
+    glm::vec2 velocityThis = particles.velocity[particleIndex];
+    for (size_t k = 0; k < neighbors.count; k++)
+    {
+        glm::vec2 relativeVelocity = particles.velocity[neighbors.index[k]] - velocityThis;
+        viscosityForce += relativeVelocity * poly6[k];
+    }
+    return viscosityForce * viscosityMultiplier;
+}
+
+/*
+ * Neighbors of a particle for the batched passes. In neighbor list mode these point into the
+ * list, which may also hold particles in the skin, their kernel values are 0. Otherwise the
+ * neighbors in range are gathered into the scratch buffers of the calling thread.
+ * Also sizes the kernel value buffers of the scratch to the neighbor count.
+ */
+SPH::NeighborRange SPH::gatherNeighbors(size_t particleIndex, NeighborScratch &scratch) const
+{
+    NeighborRange range;
+    if (useNeighborList)
+    {
+        unsigned int start = neighborListStart[particleIndex];
+        range = {
+            neighborListIndex.data() + start,
+            neighborListDistance.data() + start,
+            neighborListDirection.data() + start,
+            neighborListStart[particleIndex + 1] - start};
+    }
+    else
+    {
+        scratch.index.clear();
+        scratch.distance.clear();
+        scratch.direction.clear();
+        foreachNeighborInRange(
+            particleIndex, [&](size_t neighborIndex, float distance, glm::vec2 direction) {
+                scratch.index.push_back(static_cast<unsigned int>(neighborIndex));
+                scratch.distance.push_back(distance);
+                scratch.direction.push_back(direction);
+            });
+        range = {
+            scratch.index.data(),
+            scratch.distance.data(),
+            scratch.direction.data(),
+            scratch.index.size()};
+    }
+
+    for (std::vector<float> &kernelValue : scratch.kernelValue)
+        if (kernelValue.size() < range.count)
+            kernelValue.resize(range.count);
+    return range;
+}
 
-        glm::vec2 relativeVelocity = velocityData[neighborIndex] - velocityData[particleIndex];
-        viscosityForce += relativeVelocity * kernelPoly6_2D(distance, smoothRadius);
+/*
+ * Compare a batched kernel path against the scalar kernel functions over distances spanning the
+ * smooth radius, the count is not a multiple of any simd width so partial batches are covered.
+ * Returns the largest absolute error relative to the peak magnitude of each kernel.
+ */
+float SPH::validateKernelBatch(const SphKernelBatch &batch) const
+{
+    const size_t sampleCount = 1001;
+    std::vector<float> distance(sampleCount);
+    std::vector<float> batchValue(sampleCount);
+    for (size_t i = 0; i < sampleCount; i++)
+        distance[i] = 1.25f * smoothRadius * static_cast<float>(i) / (sampleCount - 1);
+
+    float maxError = 0.f;
+    auto compare = [&](SphKernelBatch::Function batchKernel, float scale, auto &&scalarKernel) {
+        batchKernel(distance.data(), batchValue.data(), sampleCount, smoothRadius, scale);
+        float peak = 0.f;
+        float error = 0.f;
+        for (size_t i = 0; i < sampleCount; i++)
+        {
+            float reference = scalarKernel(distance[i]);
+            peak = std::max(peak, std::abs(reference));
+            error = std::max(error, std::abs(batchValue[i] - reference));
+        }
+        maxError = std::max(maxError, error / peak);
+    };
+
+    compare(batch.poly6, scalingFactorPoly6_2D, [&](float d) {
+        return kernelPoly6_2D(d, smoothRadius);
     });
-    return viscosityForce * viscosityMultiplier;
+    compare(batch.spikyPow3, scalingFactorSpikyPow3_2D, [&](float d) {
+        return kernelSpikyPow3_2D(d, smoothRadius);
+    });
+    compare(batch.derivativeSpikyPow3, scalingFactorSpikyPow3_2D, [&](float d) {
+        return derivativeSpikyPow3_2D(d, smoothRadius);
+    });
+    compare(batch.spikyPow2, scalingFactorSpikyPow2_2D, [&](float d) {
+        return kernelSpikyPow2_2D(d, smoothRadius);
+    });
+    compare(batch.derivativeSpikyPow2, scalingFactorSpikyPow2_2D, [&](float d) {
+        return derivativeSpikyPow2_2D(d, smoothRadius);
+    });
+    return maxError;
+}
+
+/*
+ * Counting sort of particles by spacial key, linear in particle count plus key count. Fills
+ * spacialLookup in key order and spacialLookupEntry with the start offset of each key (-1 if no
+ * particle has the key) in the same pass.
+ */
+void SPH::buildSpacialLookup()
+{
+    // count particles per key
+    std::fill(spacialLookupCursor.begin(), spacialLookupCursor.end(), 0);
+    for (size_t i = 0; i < particleCount; i++)
+        spacialLookupCursor[spacialHashKeyData[i]]++;
+
+    // exclusive prefix sum gives the start offset of each key
+    unsigned int offset = 0;
+    for (size_t key = 0; key < spacialKeyCount; key++)
+    {
+        unsigned int count = spacialLookupCursor[key];
+        spacialLookupEntry[key] = count == 0 ? -1 : static_cast<int>(offset);
+        spacialLookupCursor[key] = offset;
+        offset += count;
+    }
+
+    // stable scatter, particles sharing a key keep their relative order
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        unsigned int key = spacialHashKeyData[i];
+        spacialLookup[spacialLookupCursor[key]++] = {static_cast<uint32_t>(i), key};
+    }
+}
+
+/*
+ * Permute particle data into spacial lookup order, so particles of the same cell are adjacent in
+ * memory and neighbor loops walk contiguous data instead of gathering across the whole array.
+ * Density and forces are recalculated after this point every step, so they are not permuted.
+ */
+void SPH::reorderParticleData()
+{
+    permuteBySpacialLookup(particles.position);
+    permuteBySpacialLookup(particles.velocity);
+    permuteBySpacialLookup(nextPositionData);
+    permuteBySpacialLookup(massData);
+    permuteBySpacialLookup(particleIdData);
+
+    for (size_t i = 0; i < particleCount; i++)
+    {
+        spacialLookup[i].particleIndex = static_cast<uint32_t>(i);
+        particleIndexData[particleIdData[i]] = i;
+    }
+}
+
+void SPH::permuteBySpacialLookup(ParticleVec2Array &data)
+{
+    permuteBySpacialLookup(data.x);
+    permuteBySpacialLookup(data.y);
+}
+
+void SPH::permuteBySpacialLookup(ParticleFloatArray &data)
+{
+    reorderFloatBuffer.resize(particleCount);
+    for (size_t i = 0; i < particleCount; i++)
+        reorderFloatBuffer[i] = data[spacialLookup[i].particleIndex];
+    data.swap(reorderFloatBuffer);
+}
+
+void SPH::permuteBySpacialLookup(std::vector<unsigned int> &data)
+{
+    reorderUintBuffer.resize(particleCount);
+    for (size_t i = 0; i < particleCount; i++)
+        reorderUintBuffer[i] = data[spacialLookup[i].particleIndex];
+    data.swap(reorderUintBuffer);
+}
+
+bool SPH::isNeighborListOutdated() const
+{
+    if (neighborListOutdated || neighborListSkin <= 0.f)
+        return true;
+
+    // two particles approaching each other by at most skin in total can not cross the cutoff
+    float maxDisplacement = 0.5f * neighborListSkin;
+    float maxDisplacement2 = maxDisplacement * maxDisplacement;
+    int outdated = 0;
+#pragma omp parallel for reduction(| : outdated)
+    for (int i = 0; i < particleCount; i++)
+    {
+        glm::vec2 displacement = nextPositionData[i] - neighborListBuildPosition[i];
+        if (glm::dot(displacement, displacement) > maxDisplacement2)
+            outdated = 1;
+    }
+    return outdated != 0;
+}
+
+/*
+ * Collect neighbors within searchRadius from the spacial lookup into the CSR arrays in a single
+ * traversal. Each thread gathers a contiguous particle range into its own buffer, static schedule
+ * hands out ranges in thread order so concatenating the buffers keeps the particle order.
+ */
+void SPH::buildNeighborList()
+{
+    for (std::vector<unsigned int> &buffer : neighborListThreadBuffer)
+        buffer.clear();
+    neighborListThreadBuffer.resize(omp_get_max_threads());
+
+#pragma omp parallel
+    {
+        std::vector<unsigned int> &buffer = neighborListThreadBuffer[omp_get_thread_num()];
+#pragma omp for schedule(static)
+        for (int i = 0; i < particleCount; i++)
+        {
+            glm::vec2 particleNextPos = nextPositionData[i];
+            size_t bufferStart = buffer.size();
+            foreachNeighbor(i, [&](size_t neighborIndex) {
+                if (glm::length(nextPositionData[neighborIndex] - particleNextPos) < searchRadius)
+                    buffer.push_back(static_cast<unsigned int>(neighborIndex));
+            });
+            neighborListStart[i + 1] = static_cast<unsigned int>(buffer.size() - bufferStart);
+        }
+    }
+
+    neighborListStart[0] = 0;
+    for (size_t i = 0; i < particleCount; i++)
+        neighborListStart[i + 1] += neighborListStart[i];
+
+    size_t entryCount = neighborListStart[particleCount];
+    neighborListIndex.resize(entryCount);
+    neighborListDistance.resize(entryCount);
+    neighborListDirection.resize(entryCount);
+
+    auto entry = neighborListIndex.begin();
+    for (const std::vector<unsigned int> &buffer : neighborListThreadBuffer)
+        entry = std::copy(buffer.begin(), buffer.end(), entry);
+
+    for (size_t i = 0; i < particleCount; i++)
+        neighborListBuildPosition[i] = nextPositionData[i];
+    neighborListOutdated = false;
+}
+
+// update distance and direction of every listed pair from the predicted positions of this step
+void SPH::refreshNeighborList()
+{
+#pragma omp parallel for
+    for (int i = 0; i < particleCount; i++)
+    {
+        glm::vec2 particleNextPos = nextPositionData[i];
+        unsigned int end = neighborListStart[i + 1];
+        for (unsigned int entry = neighborListStart[i]; entry < end; entry++)
+        {
+            size_t neighborIndex = neighborListIndex[entry];
+            glm::vec2 offset = nextPositionData[neighborIndex] - particleNextPos;
+            float distance = glm::length(offset);
+            neighborListDistance[entry] = distance;
+            neighborListDirection[entry] =
+                getNeighborDirection(i, neighborIndex, offset, distance);
+        }
+    }
 }
 
 glm::int2 SPH::pos2gridCoord(glm::vec2 position, float gridWidth) const
@@ -401,47 +946,90 @@ glm::int2 SPH::pos2gridCoord(glm::vec2 position, float gridWidth) const
     return {x, y};
 }
 
-int SPH::hashGridCoord2D(glm::int2 gridCoord) const
+void SPH::setNeighborSearch(NeighborSearch search)
 {
-    return static_cast<uint32_t>(gridCoord.x) * 15823 +
-        static_cast<uint32_t>(gridCoord.y) * 9737333;
+    neighborSearch = search;
+    updateSpacialGrid();
 }
 
 /*
- * Iterate over all neighbors of a particle, excluding itself
- * @param particleIndex: index of the particle
- * @param callback: function to be called for each neighbor
+ * Size the key range of the spacial lookup for the current search mode. The dense grid covers the
+ * window with cells of searchRadius, particles outside of it are clamped into the border cells,
+ * which keeps any two particles within searchRadius in the same or adjacent cells.
  */
-void SPH::foreachNeighbor(size_t particleIndex, std::function<void(int)> callback)
+void SPH::updateSpacialGrid()
 {
-    glm::vec2 particleNextPos = nextPositionData[particleIndex];
-    glm::int2 gridPos = pos2gridCoord(particleNextPos, smoothRadius);
-    float smoothRadius_mul_2 = 2.f * smoothRadius;
-    for (int i = 0; i < 9; i++)
+    if (neighborSearch == DENSE)
     {
-        glm::int2 offsetGridPos = gridPos + offset2D[i];
-        unsigned int hashKey =
-            lve::math::positiveMod(hashGridCoord2D(offsetGridPos), particleCount);
-        int startIndex = spacialLookupEntry[hashKey];
-        if (startIndex == -1) // no particle in this grid
-            continue;
-
-        for (int j = startIndex; j < particleCount; j++)
-        {
-            if (spacialLookup[j].spatialHashKey != hashKey)
-                break;
+        glm::vec2 cellCount = glm::ceil(scaledWindowExtent / searchRadius);
+        denseGridSize.x = std::max(1, static_cast<int>(cellCount.x));
+        denseGridSize.y = std::max(1, static_cast<int>(cellCount.y));
+        spacialKeyCount = static_cast<size_t>(denseGridSize.x) * denseGridSize.y;
+    }
+    else
+        spacialKeyCount = particleCount;
 
-            size_t neighborIndex = spacialLookup[j].particleIndex;
+    spacialLookupEntry.assign(spacialKeyCount, -1);
+    spacialLookupCursor.resize(spacialKeyCount);
+    neighborListOutdated = true;
+}
+
+glm::int2 SPH::getSpacialCell(glm::vec2 position) const
+{
+    glm::int2 cell = pos2gridCoord(position, searchRadius);
+    if (neighborSearch == DENSE)
+    {
+        cell.x = std::clamp(cell.x, 0, denseGridSize.x - 1);
+        cell.y = std::clamp(cell.y, 0, denseGridSize.y - 1);
+    }
+    return cell;
+}
+
+unsigned int SPH::getSpacialKey(glm::int2 cell) const
+{
+    if (neighborSearch == DENSE)
+        return static_cast<unsigned int>(cell.y * denseGridSize.x + cell.x);
+    return lve::math::positiveMod(hashGridCoord2D(cell), particleCount);
+}
 
-            // simple check to skip hash collision
-            glm::vec2 neighborNextPos = nextPositionData[neighborIndex];
-            if (std::abs(neighborNextPos.x - particleNextPos.x) > smoothRadius_mul_2 ||
-                std::abs(neighborNextPos.y - particleNextPos.y) > smoothRadius_mul_2)
-                continue;
+/*
+ * Walk the buckets of the spacial lookup and count particles whose cell differs from the first
+ * particle of their bucket. Cells are taken from the current predicted positions, so the stats are
+ * exact for the lookup built in the last step, or the last rebuild in neighbor list mode.
+ */
+SPH::NeighborSearchStats SPH::getNeighborSearchStats() const
+{
+    NeighborSearchStats stats = {spacialKeyCount, 0, 0, 0, 0};
+    size_t runStart = 0;
+    while (runStart < particleCount)
+    {
+        unsigned int key = spacialLookup[runStart].spatialHashKey;
+        glm::int2 firstCell =
+            getSpacialCell(nextPositionData[spacialLookup[runStart].particleIndex]);
+        size_t collidingCount = 0;
+        size_t runEnd = runStart;
+        for (; runEnd < particleCount && spacialLookup[runEnd].spatialHashKey == key; runEnd++)
+        {
+            glm::int2 cell = getSpacialCell(nextPositionData[spacialLookup[runEnd].particleIndex]);
+            if (cell.x != firstCell.x || cell.y != firstCell.y)
+                collidingCount++;
+        }
 
-            if (neighborIndex != particleIndex)
-                callback(neighborIndex);
+        stats.occupiedBucketCount++;
+        stats.maxParticlesPerBucket = std::max(stats.maxParticlesPerBucket, runEnd - runStart);
+        if (collidingCount > 0)
+        {
+            stats.collidingBucketCount++;
+            stats.collidingParticleCount += collidingCount;
         }
+        runStart = runEnd;
     }
+    return stats;
+}
+
+int SPH::hashGridCoord2D(glm::int2 gridCoord) const
+{
+    return static_cast<uint32_t>(gridCoord.x) * 15823 +
+        static_cast<uint32_t>(gridCoord.y) * 9737333;
 }
 } // namespace app::fluidsim
\ No newline at end of file
@@ -1,16 +1,23 @@
 #pragma once
 
+#include "particle_storage.hpp"
+#include "sph_kernel.hpp"
+
 // lve
 #include "lve/GO/geo/line.hpp"
+#include "lve/util/checkpoint.hpp"
 #include "lve/util/config.hpp"
 #include "lve/util/file_io.hpp"
 #include "lve/util/math.hpp"
+#include "lve/util/phase_timer.hpp"
 
 // libs
 #include "include/glm.hpp"
 #include <vulkan/vulkan.h>
 
 // std
+#include <cstdint>
+#include <random>
 #include <string>
 #include <vector>
 
@@ -20,6 +27,7 @@ class SPH
 {
 public:
     SPH(VkExtent2D windowExtent);
+    SPH(VkExtent2D windowExtent, size_t particleCount); // overrides particleCount in config
 
     void reloadConfigParam();
 
@@ -30,11 +38,84 @@ public:
     float getSmoothRadius() const { return smoothRadius; }
     float getTargetDensity() const { return targetDensity; }
     float getDataScale() const { return dataScale; }
-    const std::vector<glm::vec2> &getPositionData() const { return positionData; }
-    const std::vector<glm::vec2> &getVelocityData() const { return velocityData; }
+    float getMaxParticleSpeed() const;
+    const ParticleStorage &getParticles() const { return particles; }
 
     void setRangeForcePos(bool sign, glm::vec2 mousePosition);
 
+    // parameters of the update rules, to run the same scene on another backend such as GpuSPH
+    struct SimParams
+    {
+        float smoothRadius;
+        float boundaryMultipler;
+        float targetDensity;
+        float pressureMultiplier;
+        float nearPressureMultiplier;
+        float viscosityMultiplier;
+        float gravityAccValue;
+        float dataScale;
+        float rangeForceScale;
+        float rangeForceRadius;
+        float lookAheadTime;
+        float maxDeltaTime;
+        float boundaryMargin;
+        glm::vec2 scaledWindowExtent;
+        float scalingFactorPoly6;
+        float scalingFactorSpikyPow3;
+        float scalingFactorSpikyPow2;
+    };
+    SimParams getSimParams() const;
+    size_t getStepCount() const { return stepCount; }
+
+    // checkpoints hold the parameters and the full particle state, a loaded checkpoint continues
+    // bit exactly like the run that wrote it, given the same simd level of the kernels
+    static constexpr const char *CHECKPOINT_KIND = "sph";
+    static constexpr uint32_t CHECKPOINT_VERSION = 1;
+    void writeCheckpoint(lve::CheckpointWriter &writer) const;
+    void readCheckpoint(const lve::CheckpointReader &reader); // replaces parameters and particles
+    uint64_t getStateHash() const; // of positions and velocities, to compare runs
+
+    // profiling
+    enum Phase
+    {
+        HASHING,
+        SORT,
+        NEIGHBOR_LIST,
+        DENSITY,
+        FORCES,
+        INTEGRATION,
+        PHASE_COUNT
+    };
+    const lve::PhaseTimer<PHASE_COUNT> &getPhaseTimer() const { return phaseTimer; }
+    void resetPhaseTimer() { phaseTimer.reset(); }
+
+    // neighbor search
+    enum NeighborSearch
+    {
+        HASHED, // hashed cells with particleCount buckets, for unbounded domains
+        DENSE   // one bucket per cell of a grid over the window, for bounded domains
+    };
+    struct NeighborSearchStats
+    {
+        size_t bucketCount;
+        size_t occupiedBucketCount;
+        size_t maxParticlesPerBucket;
+        size_t collidingBucketCount; // buckets holding particles of more than one cell
+        size_t collidingParticleCount; // particles sharing a bucket with another cell
+    };
+    void setNeighborSearch(NeighborSearch search);
+    NeighborSearch getNeighborSearch() const { return neighborSearch; }
+    NeighborSearchStats getNeighborSearchStats() const; // computed from the last spacial lookup
+    void setNeighborListMode(bool enabled, float skin);
+    bool isNeighborListOn() const { return useNeighborList; }
+    size_t getNeighborListMemoryUsage() const; // in bytes, 0 when neighbor list is off
+    size_t getSpacialLookupMemoryUsage() const; // in bytes
+
+    // batched kernels used by the density and force passes, the best simd level by default
+    void setKernelBatch(const SphKernelBatch &batch) { kernelBatch = &batch; }
+    const SphKernelBatch &getKernelBatch() const { return *kernelBatch; }
+    float validateKernelBatch(const SphKernelBatch &batch) const;
+
     // control and debug
     enum DebugLineType
     {
@@ -49,19 +130,17 @@ public:
     bool isDebugLineOn() const { return isDebugLineVisible; }
     bool isNeighborViewOn() const { return isNeighborViewActive; }
     void setDebugLineType(DebugLineType type) { debugLineType = type; }
+    // particle data may be reordered by cell, the first particle is the one with id 0 and the
+    // returned neighbor indices address the current data arrays
+    size_t getFirstParticleIndex() const { return particleIndexData[0]; }
     const std::vector<int> &getFirstParticleNeighborIndex() const
     {
         return firstParticleNeighborIndex;
     }
+    const std::vector<unsigned int> &getParticleIdData() const { return particleIdData; }
     std::vector<lve::Line> &getDebugLines() { return debugLines; }
 
 private:
-    struct SpatialHashEntry
-    {
-        size_t particleIndex;
-        unsigned int spatialHashKey;
-    };
-
     size_t particleCount;
     VkExtent2D windowExtent;
     glm::vec2 scaledWindowExtent;
@@ -79,6 +158,7 @@ private:
     std::vector<glm::vec2> pressureForceData;
     std::vector<glm::vec2> externalForceData;
     std::vector<glm::vec2> viscosityForceData;
+    lve::PhaseTimer<PHASE_COUNT> phaseTimer;
 
     // simulation parameters
     float smoothRadius;
@@ -92,8 +172,38 @@ private:
     float rangeForceScale;
     float rangeForceRadius;
     float lookAheadTime = 1.0f / 120.0f;
-    float maxDeltaTime = 1.0f / 120.0f;
+    float maxDeltaTime; // shared with the substep scheduler, only caps unplanned steps
     float boundaryMargin = 0.5f;
+    int reorderInterval; // steps between reordering particle data by cell, 0 disables it
+    int stepsUntilReorder = 0;
+    size_t stepCount = 0;
+    std::mt19937 rng; // seeded from config
+
+    // parameters section of a checkpoint
+    struct CheckpointParams
+    {
+        uint64_t particleCount;
+        uint64_t stepCount;
+        uint32_t windowWidth;
+        uint32_t windowHeight;
+        float smoothRadius;
+        float boundaryMultipler;
+        float targetDensity;
+        float pressureMultiplier;
+        float nearPressureMultiplier;
+        float viscosityMultiplier;
+        float gravityAccValue;
+        float dataScale;
+        float rangeForceScale;
+        float rangeForceRadius;
+        int32_t reorderInterval;
+        int32_t stepsUntilReorder;
+        int32_t neighborSearch;
+        int32_t useNeighborList;
+        float neighborListSkin;
+        int32_t neighborListOutdated;
+        int32_t simdLevel;
+    };
 
     // particle data
     struct Density
@@ -101,13 +211,16 @@ private:
         float density;
         float nearDensity;
     };
-    std::vector<glm::vec2> positionData;
-    std::vector<glm::vec2> nextPositionData;
-    std::vector<glm::vec2> velocityData;
+    ParticleStorage particles;
+    ParticleVec2Array nextPositionData;
     std::vector<Density> densityData;
-    std::vector<float> massData;
+    ParticleFloatArray massData;
+    std::vector<unsigned int> particleIdData;    // external particle id of each data index
+    std::vector<unsigned int> particleIndexData; // data index of each external particle id
+    void resizeParticleData();
     void initParticleData(glm::vec2 startPoint, float stride, float maxWidth, bool randomize);
     void initSimParams();
+    void initDerivedParams();
     glm::vec2 scaledPos2ScreenPos(glm::vec2 scaledPos) const;
 
     // kernels
@@ -129,13 +242,56 @@ private:
     glm::vec2 calculateExternalForce(size_t particleIndex);
     glm::vec2 calculateViscosityForce(size_t particleIndex);
     glm::vec2 calculateNearPressureForce(size_t particleIndex);
+    const SphKernelBatch *kernelBatch = &getSphKernelBatch();
+    glm::vec2 getCoincidentDirection(size_t particleIndex, size_t neighborIndex) const;
+    glm::vec2 getNeighborDirection(
+        size_t particleIndex, size_t neighborIndex, glm::vec2 offset, float distance) const;
+    template <typename Callback>
+    void foreachNeighborInRange(size_t particleIndex, Callback &&callback) const;
+
+    // neighbors of one particle as SoA arrays, so kernels can be evaluated in batches
+    struct NeighborRange
+    {
+        const unsigned int *index;
+        const float *distance;
+        const glm::vec2 *direction;
+        size_t count;
+    };
+    struct NeighborScratch // per thread
+    {
+        std::vector<unsigned int> index;
+        std::vector<float> distance;
+        std::vector<glm::vec2> direction;
+        std::vector<float> kernelValue[2];
+    };
+    std::vector<NeighborScratch> neighborScratch;
+    NeighborRange gatherNeighbors(size_t particleIndex, NeighborScratch &scratch) const;
 
     // hash grid
     std::vector<SpatialHashEntry> spacialLookup;
     std::vector<int> spacialLookupEntry;
+    std::vector<unsigned int> spacialHashKeyData;
+    std::vector<unsigned int> spacialLookupCursor;
+    float searchRadius; // grid width and neighbor list cutoff, smoothRadius plus the Verlet skin
+    NeighborSearch neighborSearch;
+    glm::int2 denseGridSize;
+    size_t spacialKeyCount; // particleCount buckets when hashed, grid cells when dense
+    void updateSpacialGrid();
+    glm::int2 getSpacialCell(glm::vec2 position) const;
+    unsigned int getSpacialKey(glm::int2 cell) const;
+    void buildSpacialLookup();
+
+    // cell ordering
+    ParticleFloatArray reorderFloatBuffer;
+    std::vector<unsigned int> reorderUintBuffer;
+    void reorderParticleData();
+    void permuteBySpacialLookup(ParticleVec2Array &data);
+    void permuteBySpacialLookup(ParticleFloatArray &data);
+    void permuteBySpacialLookup(std::vector<unsigned int> &data);
     glm::int2 pos2gridCoord(glm::vec2 position, float gridWidth) const;
     int hashGridCoord2D(glm::int2 gridCoord) const;
-    void foreachNeighbor(size_t particleIndex, std::function<void(int)> callback);
+    template <typename Callback>
+    void foreachNeighbor(size_t particleIndex, Callback &&callback) const;
     const glm::int2 offset2D[9] = {
         {-1, -1},
         { 0, -1},
@@ -148,6 +304,21 @@ private:
         { 1,  1}
     };
 
+    // neighbor list, CSR layout: neighbors of particle i are entries
+    // [neighborListStart[i], neighborListStart[i + 1])
+    bool useNeighborList;
+    float neighborListSkin;
+    bool neighborListOutdated = true;
+    std::vector<unsigned int> neighborListStart;
+    std::vector<unsigned int> neighborListIndex;
+    std::vector<float> neighborListDistance;
+    std::vector<glm::vec2> neighborListDirection;
+    std::vector<glm::vec2> neighborListBuildPosition; // predicted positions at the last build
+    std::vector<std::vector<unsigned int>> neighborListThreadBuffer;
+    bool isNeighborListOutdated() const;
+    void buildNeighborList();
+    void refreshNeighborList();
+
     // external force
     struct RangeForceInfo
     {
@@ -157,4 +328,6 @@ private:
     };
     RangeForceInfo rangeForceInfo = {false, false, glm::vec2(0.0f, 0.0f)};
 };
-} // namespace app::fluidsim
\ No newline at end of file
+} // namespace app::fluidsim
+
+#include "sph.tpp"
\ No newline at end of file
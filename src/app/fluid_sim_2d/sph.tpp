@@ -0,0 +1,107 @@
+#pragma once
+
+#include "sph.hpp"
+
+namespace app::fluidsim
+{
+/*
+ * Iterate over all neighbors of a particle, excluding itself
+ * @param particleIndex: index of the particle
+ * @param callback: callable invoked with the index of each neighbor, taken as a template
+ * parameter so the per-pair work is inlined into the loop instead of called through std::function
+ */
+template <typename Callback>
+void SPH::foreachNeighbor(size_t particleIndex, Callback &&callback) const
+{
+    glm::vec2 particleNextPos = nextPositionData[particleIndex];
+    glm::int2 gridPos = getSpacialCell(particleNextPos);
+    float searchRadius_mul_2 = 2.f * searchRadius;
+
+    // particles sharing a key are in the same cell of the dense grid, hashed keys can collide
+    auto visitKey = [&](unsigned int key, bool checkCollision) {
+        int startIndex = spacialLookupEntry[key];
+        if (startIndex == -1) // no particle in this grid
+            return;
+
+        for (size_t j = startIndex; j < particleCount; j++)
+        {
+            if (spacialLookup[j].spatialHashKey != key)
+                break;
+
+            size_t neighborIndex = spacialLookup[j].particleIndex;
+
+            // simple check to skip hash collision
+            if (checkCollision)
+            {
+                glm::vec2 neighborNextPos = nextPositionData[neighborIndex];
+                if (std::abs(neighborNextPos.x - particleNextPos.x) > searchRadius_mul_2 ||
+                    std::abs(neighborNextPos.y - particleNextPos.y) > searchRadius_mul_2)
+                    continue;
+            }
+
+            if (neighborIndex != particleIndex)
+                callback(neighborIndex);
+        }
+    };
+
+    if (neighborSearch == DENSE)
+    {
+        for (int i = 0; i < 9; i++)
+        {
+            glm::int2 cell = gridPos + offset2D[i];
+            if (cell.x < 0 || cell.y < 0 || cell.x >= denseGridSize.x || cell.y >= denseGridSize.y)
+                continue;
+            visitKey(getSpacialKey(cell), false);
+        }
+        return;
+    }
+
+    for (int i = 0; i < 9; i++)
+        visitKey(getSpacialKey(gridPos + offset2D[i]), true);
+}
+
+/*
+ * Iterate over neighbors closer than smoothRadius, read from the neighbor list when it is on and
+ * found through the spacial lookup otherwise. Both paths visit neighbors in the same order.
+ * @param particleIndex: index of the particle
+ * @param callback: callable invoked with (neighborIndex, distance, direction to the neighbor)
+ */
+template <typename Callback>
+void SPH::foreachNeighborInRange(size_t particleIndex, Callback &&callback) const
+{
+    if (useNeighborList)
+    {
+        unsigned int end = neighborListStart[particleIndex + 1];
+        for (unsigned int k = neighborListStart[particleIndex]; k < end; k++)
+        {
+            float distance = neighborListDistance[k];
+            if (distance < smoothRadius)
+                callback(
+                    static_cast<size_t>(neighborListIndex[k]),
+                    distance,
+                    neighborListDirection[k]);
+        }
+        return;
+    }
+
+    glm::vec2 particleNextPos = nextPositionData[particleIndex];
+    foreachNeighbor(particleIndex, [&](size_t neighborIndex) {
+        glm::vec2 offset = nextPositionData[neighborIndex] - particleNextPos;
+        float distance = glm::length(offset);
+        if (distance >= smoothRadius)
+            return;
+        callback(
+            neighborIndex,
+            distance,
+            getNeighborDirection(particleIndex, neighborIndex, offset, distance));
+    });
+}
+
+inline glm::vec2 SPH::getNeighborDirection(
+    size_t particleIndex, size_t neighborIndex, glm::vec2 offset, float distance) const
+{
+    if (distance < glm::epsilon<float>())
+        return getCoincidentDirection(particleIndex, neighborIndex);
+    return offset / distance;
+}
+} // namespace app::fluidsim
@@ -0,0 +1,57 @@
+#include "sph_kernel.hpp"
+#include "sph_kernel.tpp"
+
+// std
+#include <stdexcept>
+#include <string>
+
+namespace app::fluidsim
+{
+namespace kernel
+{
+struct Scalar
+{
+    using Vec = float;
+    static constexpr size_t WIDTH = 1;
+    static Vec set1(float value) { return value; }
+    static Vec load(const float *data) { return *data; }
+    static Vec loadPartial(const float *data, size_t) { return *data; }
+    static void store(float *data, Vec value) { *data = value; }
+    static void storePartial(float *data, Vec value, size_t) { *data = value; }
+    static Vec sub(Vec a, Vec b) { return a - b; }
+    static Vec mul(Vec a, Vec b) { return a * b; }
+    static Vec selectLess(Vec value, Vec a, Vec b) { return a < b ? value : 0.f; }
+};
+} // namespace kernel
+
+const SphKernelBatch &getSphKernelBatchScalar()
+{
+    static const SphKernelBatch batch =
+        kernel::makeBatch<kernel::Scalar>(lve::cpu::SIMD_SCALAR);
+    return batch;
+}
+
+const SphKernelBatch &getSphKernelBatch() { return getSphKernelBatch(lve::cpu::getSimdLevel()); }
+
+const SphKernelBatch &getSphKernelBatch(lve::cpu::SimdLevel level)
+{
+    if (level > lve::cpu::getSimdLevel())
+        throw std::runtime_error(
+            std::string("SIMD level not supported by this cpu: ") +
+            lve::cpu::getSimdLevelName(level));
+
+    switch (level)
+    {
+#ifdef LVE_ARCH_X86
+    case lve::cpu::SIMD_SSE4:
+        return getSphKernelBatchSse4();
+    case lve::cpu::SIMD_AVX2:
+        return getSphKernelBatchAvx2();
+    case lve::cpu::SIMD_AVX512:
+        return getSphKernelBatchAvx512();
+#endif
+    default:
+        return getSphKernelBatchScalar();
+    }
+}
+} // namespace app::fluidsim
@@ -0,0 +1,40 @@
+#pragma once
+
+// lve
+#include "lve/util/cpu.hpp"
+
+// std
+#include <cstddef>
+
+namespace app::fluidsim
+{
+/*
+ * Batched SPH smoothing kernels over arrays of neighbor distances. Every function writes
+ * out[i] = kernel(distance[i]) for i < count, or 0 where distance[i] >= radius, using the same
+ * formulas as the scalar kernels of SPH with a lane mask instead of the early out branch.
+ */
+struct SphKernelBatch
+{
+    using Function =
+        void (*)(const float *distance, float *out, size_t count, float radius, float scale);
+
+    lve::cpu::SimdLevel simdLevel;
+    Function poly6;
+    Function spikyPow3;
+    Function derivativeSpikyPow3;
+    Function spikyPow2;
+    Function derivativeSpikyPow2;
+};
+
+// kernels for the highest simd level of this cpu
+const SphKernelBatch &getSphKernelBatch();
+// kernels for a given simd level, throws if the level is not supported by this cpu or build
+const SphKernelBatch &getSphKernelBatch(lve::cpu::SimdLevel level);
+
+const SphKernelBatch &getSphKernelBatchScalar();
+#ifdef LVE_ARCH_X86
+const SphKernelBatch &getSphKernelBatchSse4();
+const SphKernelBatch &getSphKernelBatchAvx2();
+const SphKernelBatch &getSphKernelBatchAvx512();
+#endif
+} // namespace app::fluidsim
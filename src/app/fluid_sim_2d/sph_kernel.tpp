@@ -0,0 +1,102 @@
+#pragma once
+
+// Kernel bodies shared by every simd level. Only included by the sph_kernel*.cpp files, each of
+// them compiled for its own instruction set and instantiating these templates with its own Simd
+// type, so no inline code generated for a wider instruction set leaks into other translation units.
+
+#include "sph_kernel.hpp"
+
+namespace app::fluidsim::kernel
+{
+/*
+ * Simd is a set of static functions over a vector of Simd::WIDTH floats:
+ * Vec set1(float), load(const float *), loadPartial(const float *, size_t count),
+ * store(float *, Vec), storePartial(float *, Vec, size_t count), sub(Vec, Vec), mul(Vec, Vec),
+ * selectLess(Vec value, Vec a, Vec b) returning value where a < b and 0 elsewhere
+ */
+template <typename Simd, typename Kernel>
+void evaluate(const float *distance, float *out, size_t count, float radius, Kernel kernel)
+{
+    using Vec = typename Simd::Vec;
+    Vec r = Simd::set1(radius);
+    size_t i = 0;
+    for (; i + Simd::WIDTH <= count; i += Simd::WIDTH)
+    {
+        Vec d = Simd::load(distance + i);
+        Simd::store(out + i, Simd::selectLess(kernel(d, r), d, r));
+    }
+    if (i < count) // remaining lanes of the last batch
+    {
+        Vec d = Simd::loadPartial(distance + i, count - i);
+        Simd::storePartial(out + i, Simd::selectLess(kernel(d, r), d, r), count - i);
+    }
+}
+
+// operations are grouped like the scalar kernels in sph.cpp so both paths round the same way
+
+template <typename Simd>
+void poly6(const float *distance, float *out, size_t count, float radius, float scale)
+{
+    using Vec = typename Simd::Vec;
+    Vec s = Simd::set1(scale);
+    evaluate<Simd>(distance, out, count, radius, [&](Vec d, Vec r) {
+        Vec v = Simd::sub(Simd::mul(r, r), Simd::mul(d, d));
+        return Simd::mul(Simd::mul(Simd::mul(s, v), v), v);
+    });
+}
+
+template <typename Simd>
+void spikyPow3(const float *distance, float *out, size_t count, float radius, float scale)
+{
+    using Vec = typename Simd::Vec;
+    Vec s = Simd::set1(scale);
+    evaluate<Simd>(distance, out, count, radius, [&](Vec d, Vec r) {
+        Vec v = Simd::sub(r, d);
+        return Simd::mul(Simd::mul(Simd::mul(s, v), v), v);
+    });
+}
+
+template <typename Simd>
+void derivativeSpikyPow3(const float *distance, float *out, size_t count, float radius, float scale)
+{
+    using Vec = typename Simd::Vec;
+    Vec s = Simd::set1(-3.f * scale);
+    evaluate<Simd>(distance, out, count, radius, [&](Vec d, Vec r) {
+        Vec v = Simd::sub(r, d);
+        return Simd::mul(Simd::mul(s, v), v);
+    });
+}
+
+template <typename Simd>
+void spikyPow2(const float *distance, float *out, size_t count, float radius, float scale)
+{
+    using Vec = typename Simd::Vec;
+    Vec s = Simd::set1(scale);
+    evaluate<Simd>(distance, out, count, radius, [&](Vec d, Vec r) {
+        Vec v = Simd::sub(r, d);
+        return Simd::mul(Simd::mul(s, v), v);
+    });
+}
+
+template <typename Simd>
+void derivativeSpikyPow2(const float *distance, float *out, size_t count, float radius, float scale)
+{
+    using Vec = typename Simd::Vec;
+    Vec s = Simd::set1(-2.f * scale);
+    evaluate<Simd>(distance, out, count, radius, [&](Vec d, Vec r) {
+        return Simd::mul(s, Simd::sub(r, d));
+    });
+}
+
+template <typename Simd>
+SphKernelBatch makeBatch(lve::cpu::SimdLevel simdLevel)
+{
+    return {
+        simdLevel,
+        &poly6<Simd>,
+        &spikyPow3<Simd>,
+        &derivativeSpikyPow3<Simd>,
+        &spikyPow2<Simd>,
+        &derivativeSpikyPow2<Simd>};
+}
+} // namespace app::fluidsim::kernel
@@ -0,0 +1,50 @@
+// compiled with AVX2 enabled, only called after runtime detection
+#include "sph_kernel.hpp"
+#include "sph_kernel.tpp"
+
+#ifdef LVE_ARCH_X86
+
+// libs
+#include <immintrin.h>
+
+namespace app::fluidsim
+{
+namespace kernel
+{
+struct Avx2
+{
+    using Vec = __m256;
+    static constexpr size_t WIDTH = 8;
+    static __m256i laneMask(size_t count)
+    {
+        return _mm256_cmpgt_epi32(
+            _mm256_set1_epi32(static_cast<int>(count)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    }
+    static Vec set1(float value) { return _mm256_set1_ps(value); }
+    static Vec load(const float *data) { return _mm256_loadu_ps(data); }
+    static Vec loadPartial(const float *data, size_t count)
+    {
+        return _mm256_maskload_ps(data, laneMask(count));
+    }
+    static void store(float *data, Vec value) { _mm256_storeu_ps(data, value); }
+    static void storePartial(float *data, Vec value, size_t count)
+    {
+        _mm256_maskstore_ps(data, laneMask(count), value);
+    }
+    static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    static Vec selectLess(Vec value, Vec a, Vec b)
+    {
+        return _mm256_and_ps(value, _mm256_cmp_ps(a, b, _CMP_LT_OQ));
+    }
+};
+} // namespace kernel
+
+const SphKernelBatch &getSphKernelBatchAvx2()
+{
+    static const SphKernelBatch batch = kernel::makeBatch<kernel::Avx2>(lve::cpu::SIMD_AVX2);
+    return batch;
+}
+} // namespace app::fluidsim
+
+#endif
@@ -0,0 +1,49 @@
+// compiled with AVX-512F enabled, only called after runtime detection
+#include "sph_kernel.hpp"
+#include "sph_kernel.tpp"
+
+#ifdef LVE_ARCH_X86
+
+// libs
+#include <immintrin.h>
+
+namespace app::fluidsim
+{
+namespace kernel
+{
+struct Avx512
+{
+    using Vec = __m512;
+    static constexpr size_t WIDTH = 16;
+    static __mmask16 laneMask(size_t count)
+    {
+        return static_cast<__mmask16>((1u << count) - 1u);
+    }
+    static Vec set1(float value) { return _mm512_set1_ps(value); }
+    static Vec load(const float *data) { return _mm512_loadu_ps(data); }
+    static Vec loadPartial(const float *data, size_t count)
+    {
+        return _mm512_maskz_loadu_ps(laneMask(count), data);
+    }
+    static void store(float *data, Vec value) { _mm512_storeu_ps(data, value); }
+    static void storePartial(float *data, Vec value, size_t count)
+    {
+        _mm512_mask_storeu_ps(data, laneMask(count), value);
+    }
+    static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    static Vec selectLess(Vec value, Vec a, Vec b)
+    {
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(a, b, _CMP_LT_OQ), value);
+    }
+};
+} // namespace kernel
+
+const SphKernelBatch &getSphKernelBatchAvx512()
+{
+    static const SphKernelBatch batch = kernel::makeBatch<kernel::Avx512>(lve::cpu::SIMD_AVX512);
+    return batch;
+}
+} // namespace app::fluidsim
+
+#endif
@@ -0,0 +1,52 @@
+// compiled with SSE4.1 enabled, only called after runtime detection
+#include "sph_kernel.hpp"
+#include "sph_kernel.tpp"
+
+#ifdef LVE_ARCH_X86
+
+// libs
+#include <immintrin.h>
+
+// std
+#include <cstring>
+
+namespace app::fluidsim
+{
+namespace kernel
+{
+struct Sse4
+{
+    using Vec = __m128;
+    static constexpr size_t WIDTH = 4;
+    static Vec set1(float value) { return _mm_set1_ps(value); }
+    static Vec load(const float *data) { return _mm_loadu_ps(data); }
+    static Vec loadPartial(const float *data, size_t count)
+    {
+        alignas(16) float lanes[WIDTH] = {};
+        std::memcpy(lanes, data, count * sizeof(float));
+        return _mm_load_ps(lanes);
+    }
+    static void store(float *data, Vec value) { _mm_storeu_ps(data, value); }
+    static void storePartial(float *data, Vec value, size_t count)
+    {
+        alignas(16) float lanes[WIDTH];
+        _mm_store_ps(lanes, value);
+        std::memcpy(data, lanes, count * sizeof(float));
+    }
+    static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    static Vec selectLess(Vec value, Vec a, Vec b)
+    {
+        return _mm_blendv_ps(_mm_setzero_ps(), value, _mm_cmplt_ps(a, b));
+    }
+};
+} // namespace kernel
+
+const SphKernelBatch &getSphKernelBatchSse4()
+{
+    static const SphKernelBatch batch = kernel::makeBatch<kernel::Sse4>(lve::cpu::SIMD_SSE4);
+    return batch;
+}
+} // namespace app::fluidsim
+
+#endif
@@ -0,0 +1,41 @@
+#include "substep_scheduler.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace app::fluidsim
+{
+SubstepScheduler::SubstepScheduler(
+    float cflNumber, int maxSubstepCount, float maxDeltaTime, float timeScale)
+    : cflNumber(cflNumber),
+      maxSubstepCount(maxSubstepCount),
+      maxDeltaTime(maxDeltaTime),
+      timeScale(timeScale)
+{
+    if (cflNumber <= 0.0f || maxSubstepCount < 1 || maxDeltaTime <= 0.0f)
+        throw std::runtime_error("Invalid substep scheduler parameters");
+}
+
+SubstepScheduler::SubstepScheduler(const lve::YamlConfig &config)
+    : SubstepScheduler(
+          config.get<float>("cflNumber"),
+          config.get<int>("maxSubstepCount"),
+          config.get<float>("maxDeltaTime"),
+          config.get<float>("timeScale"))
+{
+}
+
+void SubstepScheduler::plan(double frameDuration, float speed, float cellSize)
+{
+    float frameTime = static_cast<float>(frameDuration) * timeScale;
+    float stableDeltaTime = maxDeltaTime;
+    if (speed > 0.0f)
+        stableDeltaTime = std::min(stableDeltaTime, cflNumber * cellSize / speed);
+
+    substepCount = static_cast<int>(std::ceil(frameTime / stableDeltaTime));
+    substepCount = std::clamp(substepCount, 1, maxSubstepCount);
+    deltaTime = std::min(frameTime / substepCount, stableDeltaTime);
+}
+} // namespace app::fluidsim
@@ -0,0 +1,38 @@
+#pragma once
+
+// lve
+#include "lve/util/config.hpp"
+
+namespace app::fluidsim
+{
+/*
+ * Splits the simulated time of a frame into the fewest equal substeps that satisfy the CFL
+ * condition, nothing may travel more than cflNumber cells (grid cells or smoothing radii) in one
+ * substep. The speed passed to plan has to cover the fastest particle and, for stiff materials,
+ * the speed of pressure waves. If more than maxSubstepCount substeps would be needed the frame
+ * simulates less time instead, the simulation slows down rather than going unstable.
+ */
+class SubstepScheduler
+{
+public:
+    SubstepScheduler(float cflNumber, int maxSubstepCount, float maxDeltaTime, float timeScale);
+    // reads cflNumber, maxSubstepCount, maxDeltaTime and timeScale
+    SubstepScheduler(const lve::YamlConfig &config);
+
+    // frameDuration in real seconds, speed and cellSize in the length unit of the solver
+    void plan(double frameDuration, float speed, float cellSize);
+
+    int getSubstepCount() const { return substepCount; }
+    float getDeltaTime() const { return deltaTime; }
+    float getSimulatedTime() const { return substepCount * deltaTime; }
+
+private:
+    float cflNumber;
+    int maxSubstepCount;
+    float maxDeltaTime;
+    float timeScale; // simulated seconds per real second
+
+    int substepCount = 0;
+    float deltaTime = 0.0f;
+};
+} // namespace app::fluidsim
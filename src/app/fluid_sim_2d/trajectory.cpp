@@ -0,0 +1,386 @@
+#include "trajectory.hpp"
+
+// std
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace app::fluidsim
+{
+namespace
+{
+const size_t STREAM_COUNT = 4;
+
+int32_t quantize(float value, float step)
+{
+    float scaled = std::round(value / step);
+    return static_cast<int32_t>(std::clamp(scaled, -2147483520.0f, 2147483520.0f));
+}
+
+uint32_t zigzag(int32_t value)
+{
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value)
+{
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+void putVarint(std::vector<uint8_t> &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t getVarint(const uint8_t *&data, const uint8_t *end)
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (data == end)
+            throw std::runtime_error("Corrupt trajectory chunk");
+        uint8_t byte = *data++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    throw std::runtime_error("Corrupt trajectory chunk");
+}
+
+const ParticleFloatArray &getStream(const ParticleStorage &particles, size_t stream)
+{
+    switch (stream)
+    {
+    case 0:
+        return particles.position.x;
+    case 1:
+        return particles.position.y;
+    case 2:
+        return particles.velocity.x;
+    default:
+        return particles.velocity.y;
+    }
+}
+
+ParticleFloatArray &getStream(ParticleStorage &particles, size_t stream)
+{
+    return const_cast<ParticleFloatArray &>(
+        getStream(static_cast<const ParticleStorage &>(particles), stream));
+}
+} // namespace
+
+TrajectoryWriter::TrajectoryWriter(
+    const std::string &filePath,
+    size_t particleCount,
+    float positionStep,
+    float velocityStep,
+    int keyframeInterval,
+    size_t queueSize)
+    : filePath(filePath), file(filePath, std::ios::binary)
+{
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open file: " + filePath);
+    if (positionStep <= 0.0f || velocityStep <= 0.0f || keyframeInterval < 1 || queueSize < 1)
+        throw std::runtime_error("Invalid trajectory settings");
+
+    header = {};
+    std::memcpy(header.magic, trajectory::MAGIC, sizeof(header.magic));
+    header.formatVersion = trajectory::FORMAT_VERSION;
+    header.keyframeInterval = static_cast<uint32_t>(keyframeInterval);
+    header.particleCount = particleCount;
+    header.positionStep = positionStep;
+    header.velocityStep = velocityStep;
+    writeBytes(&header, sizeof(header));
+
+    frames.resize(queueSize);
+    for (size_t i = 0; i < queueSize; i++)
+    {
+        frames[i].particles.resize(particleCount);
+        freeFrames.push_back(i);
+    }
+    for (std::vector<int32_t> &stream : previous)
+        stream.resize(particleCount);
+
+    ioThread = std::thread(&TrajectoryWriter::ioLoop, this);
+}
+
+TrajectoryWriter::TrajectoryWriter(
+    const std::string &filePath, size_t particleCount, const lve::YamlConfig &config)
+    : TrajectoryWriter(
+          filePath,
+          particleCount,
+          config.get<float>("trajectoryPositionStep"),
+          config.get<float>("trajectoryVelocityStep"),
+          config.get<int>("trajectoryKeyframeInterval"),
+          config.get<size_t>("trajectoryQueueSize"))
+{
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception &)
+    {
+        // errors are only reported by an explicit close
+    }
+}
+
+bool TrajectoryWriter::addFrame(
+    const ParticleStorage &particles, double time, const std::vector<unsigned int> *particleId)
+{
+    if (particles.getSize() != header.particleCount)
+        throw std::runtime_error("Trajectory frame has a different particle count");
+
+    size_t frameIndex;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closing)
+            throw std::runtime_error("Trajectory writer is closed: " + filePath);
+        if (freeFrames.empty())
+        {
+            droppedFrameCount++;
+            return false;
+        }
+        frameIndex = freeFrames.back();
+        freeFrames.pop_back();
+    }
+
+    Frame &frame = frames[frameIndex];
+    frame.time = time;
+    if (particleId)
+    {
+        for (size_t i = 0; i < header.particleCount; i++)
+        {
+            unsigned int id = (*particleId)[i];
+            frame.particles.position.set(id, particles.position[i]);
+            frame.particles.velocity.set(id, particles.velocity[i]);
+        }
+    }
+    else
+        frame.particles = particles; // reuses the frame's allocation
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queuedFrames.push_back(frameIndex);
+    }
+    frameQueued.notify_one();
+    return true;
+}
+
+void TrajectoryWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (closing)
+            return;
+        closing = true;
+    }
+    frameQueued.notify_one();
+    ioThread.join();
+
+    if (!ioError)
+    {
+        try
+        {
+            trajectory::Footer footer{};
+            footer.indexOffset = writtenByteCount;
+            footer.frameCount = index.size();
+            std::memcpy(footer.magic, trajectory::FOOTER_MAGIC, sizeof(footer.magic));
+            writeBytes(index.data(), index.size() * sizeof(trajectory::IndexEntry));
+            writeBytes(&footer, sizeof(footer));
+            file.close();
+        }
+        catch (...)
+        {
+            ioError = std::current_exception();
+        }
+    }
+    if (ioError)
+        std::rethrow_exception(ioError);
+}
+
+void TrajectoryWriter::ioLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        frameQueued.wait(lock, [this] { return closing || !queuedFrames.empty(); });
+        if (queuedFrames.empty())
+            return; // closing with nothing left to write
+
+        size_t frameIndex = queuedFrames.front();
+        queuedFrames.pop_front();
+        lock.unlock();
+        try
+        {
+            if (!ioError)
+                writeFrame(frames[frameIndex]);
+        }
+        catch (...)
+        {
+            ioError = std::current_exception(); // later frames are discarded
+        }
+        lock.lock();
+        freeFrames.push_back(frameIndex);
+    }
+}
+
+void TrajectoryWriter::writeFrame(const Frame &frame)
+{
+    bool keyframe = index.empty() ||
+        framesSinceKeyframe + 1 >= static_cast<int>(header.keyframeInterval);
+    framesSinceKeyframe = keyframe ? 0 : framesSinceKeyframe + 1;
+
+    payload.clear();
+    for (size_t stream = 0; stream < STREAM_COUNT; stream++)
+    {
+        const ParticleFloatArray &values = getStream(frame.particles, stream);
+        float step = stream < 2 ? header.positionStep : header.velocityStep;
+        std::vector<int32_t> &last = previous[stream];
+        for (size_t i = 0; i < header.particleCount; i++)
+        {
+            int32_t value = quantize(values[i], step);
+            // wrapping difference, decoding adds it back with the same wrap
+            uint32_t delta = static_cast<uint32_t>(value) - static_cast<uint32_t>(last[i]);
+            putVarint(payload, zigzag(keyframe ? value : static_cast<int32_t>(delta)));
+            last[i] = value;
+        }
+    }
+
+    trajectory::ChunkHeader chunk{};
+    chunk.payloadSize = static_cast<uint32_t>(payload.size());
+    chunk.flags = keyframe ? trajectory::KEYFRAME : 0;
+    chunk.time = frame.time;
+    index.push_back({writtenByteCount, frame.time, chunk.flags, 0});
+    writeBytes(&chunk, sizeof(chunk));
+    writeBytes(payload.data(), payload.size());
+    writtenFrameCount++;
+}
+
+void TrajectoryWriter::writeBytes(const void *data, size_t size)
+{
+    file.write(static_cast<const char *>(data), size);
+    if (!file)
+        throw std::runtime_error("Failed to write trajectory: " + filePath);
+    writtenByteCount += size;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string &filePath)
+    : filePath(filePath), file(filePath, std::ios::binary | std::ios::ate)
+{
+    if (!file.is_open())
+        throw std::runtime_error("Failed to open file: " + filePath);
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if (!file || std::memcmp(header.magic, trajectory::MAGIC, sizeof(header.magic)) != 0)
+        throw std::runtime_error("Not a trajectory file: " + filePath);
+    if (header.formatVersion != trajectory::FORMAT_VERSION)
+        throw std::runtime_error(
+            "Unsupported trajectory format version " + std::to_string(header.formatVersion) +
+            ": " + filePath);
+
+    trajectory::Footer footer{};
+    if (fileSize >= sizeof(header) + sizeof(footer))
+    {
+        file.seekg(fileSize - sizeof(footer));
+        file.read(reinterpret_cast<char *>(&footer), sizeof(footer));
+    }
+    bool hasIndex =
+        std::memcmp(footer.magic, trajectory::FOOTER_MAGIC, sizeof(footer.magic)) == 0 &&
+        footer.indexOffset + footer.frameCount * sizeof(trajectory::IndexEntry) + sizeof(footer) ==
+            fileSize;
+    if (hasIndex)
+    {
+        index.resize(footer.frameCount);
+        file.seekg(footer.indexOffset);
+        file.read(reinterpret_cast<char *>(index.data()), index.size() * sizeof(index[0]));
+        if (!file)
+            throw std::runtime_error("Failed to read trajectory index: " + filePath);
+    }
+    else
+        scanChunks(fileSize);
+
+    for (std::vector<int32_t> &stream : current)
+        stream.resize(header.particleCount);
+    particles.resize(header.particleCount);
+}
+
+void TrajectoryReader::scanChunks(uint64_t fileSize)
+{
+    uint64_t offset = sizeof(header);
+    trajectory::ChunkHeader chunk;
+    while (offset + sizeof(chunk) <= fileSize)
+    {
+        file.seekg(offset);
+        file.read(reinterpret_cast<char *>(&chunk), sizeof(chunk));
+        if (!file || offset + sizeof(chunk) + chunk.payloadSize > fileSize)
+            break;
+        index.push_back({offset, chunk.time, chunk.flags, 0});
+        offset += sizeof(chunk) + chunk.payloadSize;
+    }
+    file.clear();
+}
+
+const ParticleStorage &TrajectoryReader::readFrame(size_t frame)
+{
+    if (frame >= index.size())
+        throw std::runtime_error("Trajectory frame out of range: " + std::to_string(frame));
+
+    size_t start = frame;
+    while (!(index[start].flags & trajectory::KEYFRAME))
+    {
+        if (start == 0)
+            throw std::runtime_error("Trajectory does not start with a keyframe: " + filePath);
+        start--;
+    }
+    if (currentFrame != SIZE_MAX && currentFrame >= start && currentFrame <= frame)
+        start = currentFrame + 1;
+
+    for (size_t i = start; i <= frame; i++)
+        decodeFrame(i);
+
+    for (size_t stream = 0; stream < STREAM_COUNT; stream++)
+    {
+        ParticleFloatArray &values = getStream(particles, stream);
+        float step = stream < 2 ? header.positionStep : header.velocityStep;
+        for (size_t i = 0; i < header.particleCount; i++)
+            values[i] = current[stream][i] * step;
+    }
+    return particles;
+}
+
+void TrajectoryReader::decodeFrame(size_t frame)
+{
+    trajectory::ChunkHeader chunk;
+    file.seekg(index[frame].offset);
+    file.read(reinterpret_cast<char *>(&chunk), sizeof(chunk));
+    payload.resize(chunk.payloadSize);
+    file.read(reinterpret_cast<char *>(payload.data()), payload.size());
+    if (!file)
+        throw std::runtime_error("Failed to read trajectory frame: " + filePath);
+
+    bool keyframe = chunk.flags & trajectory::KEYFRAME;
+    const uint8_t *data = payload.data();
+    const uint8_t *end = data + payload.size();
+    for (std::vector<int32_t> &stream : current)
+        for (size_t i = 0; i < header.particleCount; i++)
+        {
+            int32_t value = unzigzag(getVarint(data, end));
+            stream[i] = keyframe ? value
+                                 : static_cast<int32_t>(
+                                       static_cast<uint32_t>(stream[i]) +
+                                       static_cast<uint32_t>(value));
+        }
+    currentFrame = frame;
+}
+} // namespace app::fluidsim
@@ -0,0 +1,181 @@
+#pragma once
+
+// app
+#include "particle_storage.hpp"
+
+// lve
+#include "lve/util/config.hpp"
+
+// std
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace app::fluidsim
+{
+/*
+ * Particle trajectory file, one chunk per frame followed by an index of all chunks.
+ *
+ * layout: Header | ChunkHeader | payload | ChunkHeader | payload ... | IndexEntry[] | Footer
+ *
+ * Positions and velocities are quantized to multiples of positionStep and velocityStep. A keyframe
+ * payload holds the quantized values, every other frame their difference to the previous frame,
+ * all as zigzag varints in four streams: position x, position y, velocity x, velocity y. Particles
+ * move little between frames, so most differences take one or two bytes instead of four.
+ */
+namespace trajectory
+{
+constexpr char MAGIC[8] = {'L', 'V', 'E', 'T', 'R', 'A', 'J', '\0'};
+constexpr char FOOTER_MAGIC[8] = {'L', 'V', 'E', 'T', 'I', 'D', 'X', '\0'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr uint32_t KEYFRAME = 1; // chunk flag
+
+struct Header
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t keyframeInterval;
+    uint64_t particleCount;
+    float positionStep;
+    float velocityStep;
+    uint32_t reserved[2];
+};
+
+struct ChunkHeader
+{
+    uint32_t payloadSize; // in bytes, following the chunk header
+    uint32_t flags;
+    double time; // simulated seconds
+};
+
+struct IndexEntry
+{
+    uint64_t offset; // of the chunk header from the start of the file
+    double time;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct Footer
+{
+    uint64_t indexOffset;
+    uint64_t frameCount;
+    char magic[8];
+};
+} // namespace trajectory
+
+/*
+ * Appends frames to a trajectory file on a background thread. addFrame only copies the particles
+ * into a free frame of a fixed queue, encoding and writing happen on the I/O thread, so the
+ * simulation never waits for the disk. If the disk falls behind and the queue is full the frame is
+ * dropped and counted, differences are always to the last written frame so no chunk is affected.
+ */
+class TrajectoryWriter
+{
+public:
+    TrajectoryWriter(
+        const std::string &filePath,
+        size_t particleCount,
+        float positionStep,
+        float velocityStep,
+        int keyframeInterval,
+        size_t queueSize);
+    // reads trajectoryPositionStep, trajectoryVelocityStep, trajectoryKeyframeInterval and
+    // trajectoryQueueSize
+    TrajectoryWriter(
+        const std::string &filePath, size_t particleCount, const lve::YamlConfig &config);
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    // returns false if the frame was dropped, particleId reorders the particles to id order
+    bool addFrame(
+        const ParticleStorage &particles,
+        double time,
+        const std::vector<unsigned int> *particleId = nullptr);
+    // writes the remaining frames and the index, rethrows errors of the I/O thread
+    void close();
+
+    size_t getWrittenFrameCount() const { return writtenFrameCount; }
+    size_t getDroppedFrameCount() const { return droppedFrameCount; }
+    uint64_t getWrittenByteCount() const { return writtenByteCount; }
+
+private:
+    struct Frame
+    {
+        ParticleStorage particles;
+        double time;
+    };
+
+    std::string filePath;
+    std::ofstream file;
+    trajectory::Header header;
+
+    // shared between the simulation and the I/O thread
+    std::vector<Frame> frames;
+    std::vector<size_t> freeFrames;
+    std::deque<size_t> queuedFrames;
+    std::mutex mutex;
+    std::condition_variable frameQueued;
+    bool closing = false;
+    std::exception_ptr ioError;
+    std::atomic<size_t> writtenFrameCount{0};
+    std::atomic<size_t> droppedFrameCount{0};
+    std::atomic<uint64_t> writtenByteCount{0};
+
+    // owned by the I/O thread
+    std::vector<int32_t> previous[4]; // quantized streams of the last written frame
+    std::vector<uint8_t> payload;
+    std::vector<trajectory::IndexEntry> index;
+    int framesSinceKeyframe = 0;
+
+    std::thread ioThread;
+    void ioLoop();
+    void writeFrame(const Frame &frame);
+    void writeBytes(const void *data, size_t size);
+};
+
+/*
+ * Random access to the frames of a trajectory file. Reading frame N decodes from the closest
+ * keyframe before it, or continues from the last frame read, so reading frames in order decodes
+ * every chunk once. Files without an index, e.g. of a crashed run, are indexed by scanning the
+ * chunks and end at the last complete one.
+ */
+class TrajectoryReader
+{
+public:
+    TrajectoryReader(const std::string &filePath);
+
+    size_t getFrameCount() const { return index.size(); }
+    size_t getParticleCount() const { return header.particleCount; }
+    double getFrameTime(size_t frame) const { return index.at(frame).time; }
+    float getPositionStep() const { return header.positionStep; }
+    float getVelocityStep() const { return header.velocityStep; }
+
+    // valid until the next call
+    const ParticleStorage &readFrame(size_t frame);
+
+private:
+    std::string filePath;
+    std::ifstream file;
+    trajectory::Header header;
+    std::vector<trajectory::IndexEntry> index;
+
+    std::vector<int32_t> current[4]; // quantized streams of currentFrame
+    size_t currentFrame = SIZE_MAX;
+    std::vector<uint8_t> payload;
+    ParticleStorage particles;
+
+    void scanChunks(uint64_t fileSize);
+    void decodeFrame(size_t frame);
+};
+} // namespace app::fluidsim
@@ -3,6 +3,8 @@
 #include "app/renderer/controller.hpp"
 #include "lve/GO/component/camera.hpp"
 #include "lve/core/pipeline/graphics_pipeline.hpp"
+#include "lve/core/pipeline/pipeline_builder.hpp"
+#include "lve/core/pipeline/pipeline_cache.hpp"
 #include "lve/core/resource/buffer.hpp"
 #include "lve/core/resource/sampler_manager.hpp"
 #include "lve/path.hpp"
@@ -16,6 +18,8 @@
 // std
 #include <cassert>
 #include <chrono>
+#include <future>
+#include <iostream>
 #include <string>
 
 namespace app::renderer
@@ -40,6 +44,32 @@ App::App()
 
 void App::run()
 {
+    globalSetLayout =
+        lve::DescriptorSetLayout::Builder(lveDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
+            .build();
+
+    // compiles on a worker while the buffers and descriptor sets are set up
+    auto graphicPipelineConfigInfo = std::make_unique<lve::GraphicPipelineConfigInfo>();
+    graphicPipelineConfigInfo->vertFilePath = "simple_shader.vert.spv";
+    graphicPipelineConfigInfo->fragFilePath = "simple_shader.frag.spv";
+    graphicPipelineConfigInfo->renderPass = lveFrameManager.getSwapChainRenderPass();
+    graphicPipelineConfigInfo->vertexBindingDescriptions =
+        lve::Model::Vertex::getBindingDescriptions();
+    graphicPipelineConfigInfo->vertexAttributeDescriptions =
+        lve::Model::Vertex::getAttributeDescriptions();
+
+    std::future<std::unique_ptr<lve::GraphicPipeline>> simpleRenderPipelineFuture =
+        lveDevice.getPipelineBuilder().build(lve::GraphicPipelineDescription{
+            lve::GraphicPipelineLayoutConfigInfo{
+                .descriptorSetLayouts = {globalSetLayout->getDescriptorSetLayout()},
+                .pushConstantRanges =
+                    {{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                      0,
+                      sizeof(lve::SimplePushConstantData)}}},
+            std::move(graphicPipelineConfigInfo)
+    });
+
     uboBuffers.resize(lve::SwapChain::MAX_FRAMES_IN_FLIGHT);
     globalDescriptorSets.resize(lve::SwapChain::MAX_FRAMES_IN_FLIGHT);
 
@@ -54,32 +84,10 @@ void App::run()
         uboBuffers[i]->map();
     }
 
-    globalSetLayout =
-        lve::DescriptorSetLayout::Builder(lveDevice)
-            .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
-            .build();
-
     updateGlobalDescriptorSets();
 
-    lve::GraphicPipelineConfigInfo graphicPipelineConfigInfo{};
-    graphicPipelineConfigInfo.vertFilePath = "simple_shader.vert.spv";
-    graphicPipelineConfigInfo.fragFilePath = "simple_shader.frag.spv";
-    graphicPipelineConfigInfo.renderPass = lveFrameManager.getSwapChainRenderPass();
-    graphicPipelineConfigInfo.vertexBindingDescriptions =
-        lve::Model::Vertex::getBindingDescriptions();
-    graphicPipelineConfigInfo.vertexAttributeDescriptions =
-        lve::Model::Vertex::getAttributeDescriptions();
-
-    lve::GraphicPipeline simpleRenderPipeline{
-        lveDevice,
-        lve::GraphicPipelineLayoutConfigInfo{
-                                             .descriptorSetLayouts = {globalSetLayout->getDescriptorSetLayout()},
-                                             .pushConstantRanges =
-                {{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-                  0,
-                  sizeof(lve::SimplePushConstantData)}}},
-        graphicPipelineConfigInfo
-    };
+    std::unique_ptr<lve::GraphicPipeline> simpleRenderPipeline = simpleRenderPipelineFuture.get();
+    lveDevice.getPipelineCache().printStats(std::cout);
 
     lve::Camera camera{};
 
@@ -121,8 +129,8 @@ void App::run()
                 commandBuffer,
                 &globalDescriptorSets[frameIndex],
                 gameObjects,
-                simpleRenderPipeline.getPipelineLayout(),
-                &simpleRenderPipeline);
+                simpleRenderPipeline->getPipelineLayout(),
+                simpleRenderPipeline.get());
 
             lveFrameManager.endSwapChainRenderPass(commandBuffer);
             lveFrameManager.endFrame();
@@ -0,0 +1,672 @@
+// Headless throughput benchmark for the fluid solvers, no window is created.
+//
+// usage: fluid-bench [--solver sph|mpm|all] [--steps N] [--max-particles N] [--csv]
+//                    [--neighbor-search hashed|dense] [--neighbor-list] [--skin R]
+//                    [--simd scalar|sse4|avx2|avx512] [--grid-count N]
+//                    [--record DIR] [--replay FILE] [--trajectory DIR] [--gpu]
+//
+// --record writes DIR/<solver>_<particles>.replay for every run, the checkpoint of the initial
+// state plus the time step of every step. --replay runs such a recording instead of the sweep and
+// fails if the final state differs from the recorded one, to compare builds on the same workload.
+// --trajectory writes DIR/<solver>_<particles>.trajectory with every timed step and reports the
+// time the solver thread spent handing frames to the writer.
+// SPH runs frames of 1/simulationRate seconds split into substeps from the CFL condition, its
+// phase times are per substep and the substeps per frame are reported.
+// --gpu also runs the compute shader SPH and MPM on a headless vulkan device, e.g. lavapipe, after
+// checking that their first steps follow the cpu solvers. Their phases are timed with gpu
+// timestamps.
+
+// app
+#include "app/fluid_sim_2d/gpu_mpm.hpp"
+#include "app/fluid_sim_2d/gpu_sph.hpp"
+#include "app/fluid_sim_2d/mpm.hpp"
+#include "app/fluid_sim_2d/replay.hpp"
+#include "app/fluid_sim_2d/sph.hpp"
+#include "app/fluid_sim_2d/substep_scheduler.hpp"
+#include "app/fluid_sim_2d/trajectory.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+#include "lve/core/memory_allocator.hpp"
+#include "lve/core/pipeline/pipeline_cache.hpp"
+#include "lve/path.hpp"
+#include "lve/util/checkpoint.hpp"
+#include "lve/util/config.hpp"
+#include "lve/util/cpu.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct BenchOptions
+{
+    bool runSph = true;
+    bool runMpm = true;
+    int steps = 10;
+    size_t maxParticleCount = 1000000;
+    bool csv = false;
+    app::fluidsim::SPH::NeighborSearch neighborSearch = app::fluidsim::SPH::HASHED;
+    bool neighborList = false;
+    float neighborListSkin = 0.f;
+    lve::cpu::SimdLevel simdLevel = lve::cpu::getSimdLevel();
+    size_t mpmGridCount = 0; // 0 keeps gridCount of the mpm config
+    std::string recordDirectory; // empty to not record
+    std::string replayFile;      // empty to run the sweep
+    std::string trajectoryDirectory; // empty to not write trajectories
+    bool gpu = false;
+};
+
+// batched kernels have to match the scalar reference up to rounding
+const float KERNEL_TOLERANCE = 1e-5f;
+// the gpu solvers sum neighbors and grid nodes in another order, their positions may differ from
+// the cpu solvers by this fraction of smoothRadius or of the mpm cell size after
+// GPU_VALIDATION_STEPS steps
+const float GPU_TOLERANCE = 1e-3f;
+const int GPU_VALIDATION_STEPS = 4;
+
+const std::vector<size_t> PARTICLE_COUNTS = {1000, 4000, 16000, 64000, 256000, 1000000};
+
+const char *SPH_PHASE_NAMES[app::fluidsim::SPH::PHASE_COUNT] = {
+    "hashing", "sort", "neighbor list", "density", "forces", "integration"};
+const char *MPM_PHASE_NAMES[app::fluidsim::MPM::PHASE_COUNT] = {
+    "binning", "activate", "stress", "p2g", "grid update", "g2p"};
+
+lve::cpu::SimdLevel parseSimdLevel(const std::string &name)
+{
+    for (int level = 0; level < lve::cpu::SIMD_LEVEL_COUNT; level++)
+        if (name == lve::cpu::getSimdLevelName(static_cast<lve::cpu::SimdLevel>(level)))
+            return static_cast<lve::cpu::SimdLevel>(level);
+    throw std::runtime_error("Unknown SIMD level: " + name);
+}
+
+BenchOptions parseOptions(int argc, char **argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--solver" && hasValue)
+        {
+            std::string solver = argv[++i];
+            options.runSph = solver == "sph" || solver == "all";
+            options.runMpm = solver == "mpm" || solver == "all";
+        }
+        else if (arg == "--steps" && hasValue)
+            options.steps = std::stoi(argv[++i]);
+        else if (arg == "--max-particles" && hasValue)
+            options.maxParticleCount = std::stoull(argv[++i]);
+        else if (arg == "--csv")
+            options.csv = true;
+        else if (arg == "--neighbor-search" && hasValue)
+        {
+            std::string search = argv[++i];
+            if (search == "hashed")
+                options.neighborSearch = app::fluidsim::SPH::HASHED;
+            else if (search == "dense")
+                options.neighborSearch = app::fluidsim::SPH::DENSE;
+            else
+                throw std::runtime_error("Unknown neighbor search: " + search);
+        }
+        else if (arg == "--neighbor-list")
+            options.neighborList = true;
+        else if (arg == "--skin" && hasValue)
+            options.neighborListSkin = std::stof(argv[++i]);
+        else if (arg == "--simd" && hasValue)
+            options.simdLevel = parseSimdLevel(argv[++i]);
+        else if (arg == "--grid-count" && hasValue)
+            options.mpmGridCount = std::stoull(argv[++i]);
+        else if (arg == "--record" && hasValue)
+            options.recordDirectory = argv[++i];
+        else if (arg == "--replay" && hasValue)
+            options.replayFile = argv[++i];
+        else if (arg == "--trajectory" && hasValue)
+            options.trajectoryDirectory = argv[++i];
+        else if (arg == "--gpu")
+            options.gpu = true;
+        else
+            throw std::runtime_error("Unknown argument: " + arg);
+    }
+    if (options.steps <= 0)
+        throw std::runtime_error("--steps must be positive");
+    return options;
+}
+
+template <typename Timer>
+void printResult(
+    const BenchOptions &options,
+    const char *solverName,
+    const char *const *phaseNames,
+    size_t phaseCount,
+    size_t particleCount,
+    const Timer &timer)
+{
+    double msPerStep = 1000.0 / options.steps;
+    double totalSeconds = timer.getTotalDuration();
+    double particleStepsPerSecond =
+        static_cast<double>(particleCount) * options.steps / totalSeconds;
+
+    if (options.csv)
+    {
+        for (size_t phase = 0; phase < phaseCount; phase++)
+            std::cout << solverName << "," << particleCount << "," << phaseNames[phase] << ","
+                      << timer.getDuration(phase) * msPerStep << "\n";
+        std::cout << solverName << "," << particleCount << ",total,"
+                  << totalSeconds * msPerStep << std::endl;
+        return;
+    }
+
+    std::cout << solverName << " | " << std::setw(8) << particleCount << " particles |";
+    for (size_t phase = 0; phase < phaseCount; phase++)
+        std::cout << " " << phaseNames[phase] << " " << std::fixed << std::setprecision(3)
+                  << timer.getDuration(phase) * msPerStep << "ms";
+    std::cout << " | total " << totalSeconds * msPerStep << "ms/step, " << std::setprecision(2)
+              << particleStepsPerSecond / 1e6 << "M particle-steps/s" << std::endl;
+}
+
+/*
+ * Collects the steps of a bench run for --record, the initial checkpoint is taken before the
+ * warm up step so a replay reproduces the whole run.
+ */
+class BenchRecorder
+{
+public:
+    template <typename Solver>
+    BenchRecorder(const BenchOptions &options, const Solver &solver)
+        : enabled(!options.recordDirectory.empty()),
+          writer(Solver::CHECKPOINT_KIND, Solver::CHECKPOINT_VERSION)
+    {
+        if (enabled)
+            solver.writeCheckpoint(writer);
+    }
+
+    void addStep(float deltaTime)
+    {
+        if (enabled)
+            recording.steps.push_back({deltaTime, 0, 0, glm::vec2(0.0f)});
+    }
+
+    template <typename Solver>
+    void write(const BenchOptions &options, const Solver &solver)
+    {
+        if (!enabled)
+            return;
+        recording.finalHash = solver.getStateHash();
+        recording.write(writer);
+        writer.write(
+            options.recordDirectory + "/" + Solver::CHECKPOINT_KIND + "_" +
+            std::to_string(solver.getParticleCount()) + ".replay");
+    }
+
+private:
+    bool enabled;
+    lve::CheckpointWriter writer;
+    app::fluidsim::ReplayRecording recording;
+};
+
+std::unique_ptr<app::fluidsim::TrajectoryWriter> createTrajectoryWriter(
+    const BenchOptions &options,
+    const char *solverName,
+    size_t particleCount,
+    const lve::YamlConfig &config)
+{
+    if (options.trajectoryDirectory.empty())
+        return nullptr;
+    return std::make_unique<app::fluidsim::TrajectoryWriter>(
+        options.trajectoryDirectory + "/" + solverName + "_" + std::to_string(particleCount) +
+            ".trajectory",
+        particleCount,
+        config);
+}
+
+void printTrajectoryResult(
+    const BenchOptions &options,
+    const char *solverName,
+    size_t particleCount,
+    app::fluidsim::TrajectoryWriter &writer,
+    double addFrameSeconds)
+{
+    writer.close();
+    double addFrameMs = addFrameSeconds * 1000.0 / options.steps;
+    double bytesPerParticle = static_cast<double>(writer.getWrittenByteCount()) /
+        (std::max<size_t>(writer.getWrittenFrameCount(), 1) * particleCount);
+    if (options.csv)
+    {
+        std::cout << solverName << "," << particleCount << ",trajectory_add_frame," << addFrameMs
+                  << "\n";
+        std::cout << solverName << "," << particleCount << ",trajectory_bytes_per_particle,"
+                  << bytesPerParticle << "\n";
+        std::cout << solverName << "," << particleCount << ",trajectory_dropped_frames,"
+                  << writer.getDroppedFrameCount() << std::endl;
+        return;
+    }
+    std::cout << "    trajectory | add frame " << std::setprecision(3) << addFrameMs << "ms/step | "
+              << writer.getWrittenFrameCount() << " frames written, "
+              << writer.getDroppedFrameCount() << " dropped | " << std::setprecision(2)
+              << bytesPerParticle << " bytes/particle/frame" << std::endl;
+}
+
+// keeps the particle number density of the configured scene by scaling the domain
+VkExtent2D getSphExtent(size_t particleCount)
+{
+    const lve::YamlConfig &config = lve::ConfigManager::getConfig(lve::path::config::FLUID_SIM_2D);
+    std::vector<int> windowSize = config.get<std::vector<int>>("windowSize");
+    double areaScale =
+        static_cast<double>(particleCount) / config.get<size_t>("particleCount");
+    double sideScale = std::sqrt(areaScale);
+    return {
+        static_cast<uint32_t>(windowSize[0] * sideScale),
+        static_cast<uint32_t>(windowSize[1] * sideScale)};
+}
+
+void benchSph(const BenchOptions &options, size_t particleCount)
+{
+    const lve::YamlConfig &config = lve::ConfigManager::getConfig(lve::path::config::FLUID_SIM_2D);
+    app::fluidsim::SPH sph(getSphExtent(particleCount), particleCount);
+    sph.setNeighborSearch(options.neighborSearch);
+    sph.setNeighborListMode(options.neighborList, options.neighborListSkin);
+    sph.setKernelBatch(app::fluidsim::getSphKernelBatch(options.simdLevel));
+    BenchRecorder recorder(options, sph);
+    std::unique_ptr<app::fluidsim::TrajectoryWriter> trajectoryWriter =
+        createTrajectoryWriter(options, "sph", particleCount, config);
+    double addFrameSeconds = 0.0;
+
+    // substeps of a frame from the CFL condition, with smoothRadius as the cell size
+    app::fluidsim::SubstepScheduler scheduler(config);
+    double frameDuration = 1.0 / config.get<float>("simulationRate");
+    auto simulateFrame = [&]() {
+        scheduler.plan(frameDuration, sph.getMaxParticleSpeed(), sph.getSmoothRadius());
+        for (int substep = 0; substep < scheduler.getSubstepCount(); substep++)
+        {
+            sph.updateParticleData(scheduler.getDeltaTime());
+            recorder.addStep(scheduler.getDeltaTime());
+        }
+    };
+    simulateFrame(); // warm up
+    sph.resetPhaseTimer();
+    int substepCount = 0;
+    int minSubstepCount = INT_MAX;
+    int maxSubstepCount = 0;
+    double simulatedTime = 0.0;
+    for (int i = 0; i < options.steps; i++)
+    {
+        simulateFrame();
+        substepCount += scheduler.getSubstepCount();
+        minSubstepCount = std::min(minSubstepCount, scheduler.getSubstepCount());
+        maxSubstepCount = std::max(maxSubstepCount, scheduler.getSubstepCount());
+        simulatedTime += scheduler.getSimulatedTime();
+        if (trajectoryWriter)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            trajectoryWriter->addFrame(sph.getParticles(), simulatedTime, &sph.getParticleIdData());
+            addFrameSeconds +=
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    recorder.write(options, sph);
+
+    // the phases are timed per substep
+    BenchOptions substepOptions = options;
+    substepOptions.steps = substepCount;
+    printResult(
+        substepOptions,
+        "sph",
+        SPH_PHASE_NAMES,
+        app::fluidsim::SPH::PHASE_COUNT,
+        particleCount,
+        sph.getPhaseTimer());
+    double substepsPerFrame = static_cast<double>(substepCount) / options.steps;
+    if (options.csv)
+        std::cout << "sph," << particleCount << ",substeps_per_frame," << substepsPerFrame
+                  << std::endl;
+    else
+        std::cout << "    substeps | " << std::setprecision(2) << substepsPerFrame
+                  << " per frame (" << minSubstepCount << "-" << maxSubstepCount << ") over "
+                  << options.steps << " frames" << std::endl;
+    if (trajectoryWriter)
+        printTrajectoryResult(options, "sph", particleCount, *trajectoryWriter, addFrameSeconds);
+
+    // memory of the two neighbor search modes, to choose between them at large particle counts
+    double spacialLookupMiB = sph.getSpacialLookupMemoryUsage() / (1024.0 * 1024.0);
+    double neighborListMiB = sph.getNeighborListMemoryUsage() / (1024.0 * 1024.0);
+    app::fluidsim::SPH::NeighborSearchStats stats = sph.getNeighborSearchStats();
+    double occupancy = static_cast<double>(stats.occupiedBucketCount) / stats.bucketCount;
+    if (options.csv)
+    {
+        std::cout << "sph," << particleCount << ",spacial_lookup_mib," << spacialLookupMiB << "\n";
+        std::cout << "sph," << particleCount << ",neighbor_list_mib," << neighborListMiB << "\n";
+        std::cout << "sph," << particleCount << ",bucket_occupancy," << occupancy << "\n";
+        std::cout << "sph," << particleCount << ",max_particles_per_bucket,"
+                  << stats.maxParticlesPerBucket << "\n";
+        std::cout << "sph," << particleCount << ",colliding_particles,"
+                  << stats.collidingParticleCount << std::endl;
+        return;
+    }
+    std::cout << "    memory | spacial lookup " << std::setprecision(2) << spacialLookupMiB
+              << "MiB | neighbor list " << neighborListMiB << "MiB" << std::endl;
+    std::cout << "    buckets | " << stats.occupiedBucketCount << "/" << stats.bucketCount
+              << " occupied (" << occupancy * 100.0 << "%) | max " << stats.maxParticlesPerBucket
+              << " particles | " << stats.collidingBucketCount << " colliding buckets with "
+              << stats.collidingParticleCount << " particles" << std::endl;
+}
+
+// largest position difference of any particle, the gpu solver stores particles in id order
+float getMaxPositionDifference(const app::fluidsim::SPH &sph, const app::fluidsim::GpuSPH &gpuSph)
+{
+    const app::fluidsim::ParticleStorage &cpuParticles = sph.getParticles();
+    const app::fluidsim::ParticleStorage &gpuParticles = gpuSph.getParticles();
+    const std::vector<unsigned int> &particleId = sph.getParticleIdData();
+    float maxDifference = 0.f;
+    for (size_t i = 0; i < sph.getParticleCount(); i++)
+        maxDifference = std::max(
+            maxDifference,
+            glm::length(cpuParticles.position[i] - gpuParticles.position[particleId[i]]));
+    return maxDifference;
+}
+
+void benchGpuSph(const BenchOptions &options, lve::Device &device, size_t particleCount)
+{
+    // the gpu solver implements the hashed search without neighbor list
+    app::fluidsim::SPH sph(getSphExtent(particleCount), particleCount);
+    sph.setNeighborSearch(app::fluidsim::SPH::HASHED);
+    sph.setNeighborListMode(false, 0.f);
+    app::fluidsim::GpuSPH gpuSph(device, sph);
+    const float deltaTime = 1.0f / 120.0f;
+
+    float maxDifference = 0.f;
+    for (int i = 0; i < GPU_VALIDATION_STEPS; i++)
+    {
+        sph.updateParticleData(deltaTime);
+        gpuSph.updateParticleData(deltaTime);
+        maxDifference = std::max(maxDifference, getMaxPositionDifference(sph, gpuSph));
+    }
+    float relativeDifference = maxDifference / sph.getSmoothRadius();
+    if (relativeDifference > GPU_TOLERANCE)
+        throw std::runtime_error(
+            "GPU SPH diverged from the CPU solver, max position difference " +
+            std::to_string(relativeDifference) + " smoothRadius");
+
+    gpuSph.resetPhaseTimer();
+    for (int i = 0; i < options.steps; i++)
+        gpuSph.updateParticleData(deltaTime);
+
+    printResult(
+        options,
+        "sph-gpu",
+        SPH_PHASE_NAMES,
+        app::fluidsim::SPH::PHASE_COUNT,
+        particleCount,
+        gpuSph.getPhaseTimer());
+    if (options.csv)
+    {
+        std::cout << "sph-gpu," << particleCount << ",max_position_difference,"
+                  << relativeDifference << std::endl;
+        return;
+    }
+    std::cout << "    validation | max position difference to cpu " << std::setprecision(6)
+              << relativeDifference << " smoothRadius after " << GPU_VALIDATION_STEPS << " steps"
+              << std::endl;
+}
+
+// check every supported batched kernel path against the scalar kernels before timing anything
+void validateSphKernels(const BenchOptions &options)
+{
+    const lve::YamlConfig &config = lve::ConfigManager::getConfig(lve::path::config::FLUID_SIM_2D);
+    std::vector<int> windowSize = config.get<std::vector<int>>("windowSize");
+    VkExtent2D extent = {
+        static_cast<uint32_t>(windowSize[0]), static_cast<uint32_t>(windowSize[1])};
+    app::fluidsim::SPH sph(extent);
+
+    if (!options.csv)
+        std::cout << "sph kernels, max relative error vs scalar |";
+    for (int level = 0; level <= lve::cpu::getSimdLevel(); level++)
+    {
+        lve::cpu::SimdLevel simdLevel = static_cast<lve::cpu::SimdLevel>(level);
+        float error = sph.validateKernelBatch(app::fluidsim::getSphKernelBatch(simdLevel));
+        if (error > KERNEL_TOLERANCE)
+            throw std::runtime_error(
+                std::string("SPH kernels mismatch the scalar reference with ") +
+                lve::cpu::getSimdLevelName(simdLevel) + ": " + std::to_string(error));
+        if (!options.csv)
+            std::cout << " " << lve::cpu::getSimdLevelName(simdLevel) << " " << error;
+    }
+    if (!options.csv)
+        std::cout << " | using " << lve::cpu::getSimdLevelName(options.simdLevel) << std::endl;
+}
+
+void benchMpm(const BenchOptions &options, size_t particleCount)
+{
+    app::fluidsim::MPM mpm = options.mpmGridCount
+                                 ? app::fluidsim::MPM(particleCount, options.mpmGridCount)
+                                 : app::fluidsim::MPM(particleCount);
+    BenchRecorder recorder(options, mpm);
+    std::unique_ptr<app::fluidsim::TrajectoryWriter> trajectoryWriter = createTrajectoryWriter(
+        options,
+        "mpm",
+        particleCount,
+        lve::ConfigManager::getConfig(lve::path::config::MPM_2D));
+    double addFrameSeconds = 0.0;
+    const float deltaTime = 1e-4f;
+    mpm.substep(deltaTime); // warm up
+    recorder.addStep(deltaTime);
+    mpm.resetPhaseTimer();
+    for (int i = 0; i < options.steps; i++)
+    {
+        mpm.substep(deltaTime);
+        recorder.addStep(deltaTime);
+        if (trajectoryWriter)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            trajectoryWriter->addFrame(mpm.getParticles(), (i + 1) * deltaTime);
+            addFrameSeconds +=
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+    recorder.write(options, mpm);
+
+    printResult(
+        options,
+        "mpm",
+        MPM_PHASE_NAMES,
+        app::fluidsim::MPM::PHASE_COUNT,
+        particleCount,
+        mpm.getPhaseTimer());
+    if (trajectoryWriter)
+        printTrajectoryResult(options, "mpm", particleCount, *trajectoryWriter, addFrameSeconds);
+
+    double activeRatio = static_cast<double>(mpm.getActiveBlockCount()) / mpm.getBlockCount();
+    if (options.csv)
+    {
+        std::cout << "mpm," << particleCount << ",active_block_ratio," << activeRatio << std::endl;
+        return;
+    }
+    std::cout << "    grid | " << mpm.getActiveBlockCount() << "/" << mpm.getBlockCount()
+              << " blocks active (" << std::setprecision(2) << activeRatio * 100.0 << "%)"
+              << std::endl;
+}
+
+void benchGpuMpm(const BenchOptions &options, lve::Device &device, size_t particleCount)
+{
+    auto createMpm = [&]() {
+        return options.mpmGridCount ? app::fluidsim::MPM(particleCount, options.mpmGridCount)
+                                    : app::fluidsim::MPM(particleCount);
+    };
+    // the same seed gives both the same particles, particles are never reordered
+    app::fluidsim::MPM mpm = createMpm();
+    app::fluidsim::MPM gpuHostState = createMpm();
+    app::fluidsim::GpuMPM gpuMpm(device, gpuHostState);
+    const float deltaTime = 1e-4f;
+
+    float maxDifference = 0.f;
+    for (int i = 0; i < GPU_VALIDATION_STEPS; i++)
+    {
+        mpm.substep(deltaTime);
+        gpuMpm.substep(deltaTime);
+        const app::fluidsim::ParticleStorage &cpuParticles = mpm.getParticles();
+        const app::fluidsim::ParticleStorage &gpuParticles = gpuMpm.getParticles();
+        for (size_t p = 0; p < particleCount; p++)
+            maxDifference = std::max(
+                maxDifference,
+                glm::length(cpuParticles.position[p] - gpuParticles.position[p]));
+    }
+    float relativeDifference = maxDifference / mpm.getCellSize();
+    if (relativeDifference > GPU_TOLERANCE)
+        throw std::runtime_error(
+            "GPU MPM diverged from the CPU solver, max position difference " +
+            std::to_string(relativeDifference) + " cells");
+
+    gpuMpm.resetPhaseTimer();
+    for (int i = 0; i < options.steps; i++)
+        gpuMpm.substep(deltaTime);
+
+    printResult(
+        options,
+        "mpm-gpu",
+        MPM_PHASE_NAMES,
+        app::fluidsim::MPM::PHASE_COUNT,
+        particleCount,
+        gpuMpm.getPhaseTimer());
+    if (options.csv)
+    {
+        std::cout << "mpm-gpu," << particleCount << ",max_position_difference,"
+                  << relativeDifference << std::endl;
+        return;
+    }
+    std::cout << "    validation | max position difference to cpu " << std::setprecision(6)
+              << relativeDifference << " cells after " << GPU_VALIDATION_STEPS << " steps"
+              << std::endl;
+}
+
+void applyReplayStep(app::fluidsim::SPH &sph, const app::fluidsim::ReplayStep &step)
+{
+    if (step.rangeForceActive)
+        sph.setRangeForcePos(step.rangeForceRepulsive != 0, step.rangeForcePosition);
+    sph.updateParticleData(step.deltaTime);
+}
+
+void applyReplayStep(app::fluidsim::MPM &mpm, const app::fluidsim::ReplayStep &step)
+{
+    mpm.substep(step.deltaTime);
+}
+
+template <typename Solver>
+void replay(
+    BenchOptions options,
+    const lve::CheckpointReader &reader,
+    Solver &solver,
+    const char *const *phaseNames,
+    size_t phaseCount)
+{
+    solver.readCheckpoint(reader);
+    app::fluidsim::ReplayRecording recording = app::fluidsim::ReplayRecording::read(reader);
+    if (recording.steps.empty())
+        throw std::runtime_error("Replay has no steps: " + options.replayFile);
+
+    solver.resetPhaseTimer();
+    for (const app::fluidsim::ReplayStep &step : recording.steps)
+        applyReplayStep(solver, step);
+
+    options.steps = static_cast<int>(recording.steps.size());
+    printResult(
+        options,
+        Solver::CHECKPOINT_KIND,
+        phaseNames,
+        phaseCount,
+        solver.getParticleCount(),
+        solver.getPhaseTimer());
+
+    uint64_t hash = solver.getStateHash();
+    if (hash != recording.finalHash)
+    {
+        std::ostringstream message;
+        message << "Replay diverged from the recording, state hash " << std::hex << hash
+                << " instead of " << recording.finalHash;
+        throw std::runtime_error(message.str());
+    }
+    if (!options.csv)
+        std::cout << "    replay | " << recording.steps.size() << " steps, state hash " << std::hex
+                  << hash << std::dec << " matches the recording" << std::endl;
+}
+
+void runReplay(const BenchOptions &options)
+{
+    lve::CheckpointReader reader(options.replayFile);
+    std::string kind = reader.getKind();
+    if (kind == app::fluidsim::SPH::CHECKPOINT_KIND)
+    {
+        const lve::YamlConfig &config =
+            lve::ConfigManager::getConfig(lve::path::config::FLUID_SIM_2D);
+        std::vector<int> windowSize = config.get<std::vector<int>>("windowSize");
+        VkExtent2D extent = {
+            static_cast<uint32_t>(windowSize[0]), static_cast<uint32_t>(windowSize[1])};
+        app::fluidsim::SPH sph(extent);
+        replay(options, reader, sph, SPH_PHASE_NAMES, app::fluidsim::SPH::PHASE_COUNT);
+    }
+    else if (kind == app::fluidsim::MPM::CHECKPOINT_KIND)
+    {
+        app::fluidsim::MPM mpm;
+        replay(options, reader, mpm, MPM_PHASE_NAMES, app::fluidsim::MPM::PHASE_COUNT);
+    }
+    else
+        throw std::runtime_error("Replay of unknown solver " + kind + ": " + options.replayFile);
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        BenchOptions options = parseOptions(argc, argv);
+        // created before the csv header, device creation logs to stdout
+        std::unique_ptr<lve::Device> device;
+        if (options.gpu && options.replayFile.empty())
+            device = std::make_unique<lve::Device>();
+        if (options.csv)
+            std::cout << "solver,particles,phase,ms_per_step" << std::endl;
+        if (!options.replayFile.empty())
+        {
+            runReplay(options);
+            return EXIT_SUCCESS;
+        }
+        if (options.runSph)
+            validateSphKernels(options);
+
+        for (size_t particleCount : PARTICLE_COUNTS)
+        {
+            if (particleCount > options.maxParticleCount)
+                break;
+            if (options.runSph)
+                benchSph(options, particleCount);
+            if (device && options.runSph)
+                benchGpuSph(options, *device, particleCount);
+            if (options.runMpm)
+                benchMpm(options, particleCount);
+            if (device && options.runMpm)
+                benchGpuMpm(options, *device, particleCount);
+        }
+        // stderr keeps the csv clean
+        if (device)
+        {
+            device->getMemoryAllocator().printStats(std::cerr);
+            device->getPipelineCache().printStats(std::cerr);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
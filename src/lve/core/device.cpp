@@ -1,5 +1,12 @@
 #include "device.hpp"
 
+// lve
+#include "lve/core/memory_allocator.hpp"
+#include "lve/core/pipeline/pipeline_builder.hpp"
+#include "lve/core/pipeline/pipeline_cache.hpp"
+#include "lve/core/transfer_context.hpp"
+#include "lve/path.hpp"
+
 // std
 #include <cstring>
 #include <iostream>
@@ -53,7 +60,7 @@ void DestroyDebugUtilsMessengerEXT(
 }
 
 // class member functions
-Device::Device(Window &window) : window{window}
+Device::Device(Window &window) : window{&window}
 {
     createInstance();
     setupDebugMessenger();
@@ -61,10 +68,32 @@ Device::Device(Window &window) : window{window}
     pickPhysicalDevice();
     createLogicalDevice();
     createCommandPool();
+    memoryAllocator = std::make_unique<MemoryAllocator>(*this);
+    transferContext = std::make_unique<TransferContext>(*this);
+    pipelineCache = std::make_unique<PipelineCache>(*this, path::cache::ROOT);
+    pipelineBuilder = std::make_unique<PipelineBuilder>(*this);
+}
+
+Device::Device() : window{nullptr}
+{
+    createInstance();
+    setupDebugMessenger();
+    pickPhysicalDevice();
+    createLogicalDevice();
+    createCommandPool();
+    memoryAllocator = std::make_unique<MemoryAllocator>(*this);
+    transferContext = std::make_unique<TransferContext>(*this);
+    pipelineCache = std::make_unique<PipelineCache>(*this, path::cache::ROOT);
+    pipelineBuilder = std::make_unique<PipelineBuilder>(*this);
 }
 
 Device::~Device()
 {
+    // queued builds finish before the cache is saved
+    pipelineBuilder.reset();
+    pipelineCache.reset();
+    transferContext.reset();
+    memoryAllocator.reset();
     vkDestroyCommandPool(device_, commandPool, nullptr);
     vkDestroyDevice(device_, nullptr);
 
@@ -149,7 +178,6 @@ void Device::pickPhysicalDevice()
         throw std::runtime_error("failed to find a suitable GPU!");
     }
 
-    VkPhysicalDeviceProperties properties;
     vkGetPhysicalDeviceProperties(physicalDevice, &properties);
     std::cout << "physical device: " << properties.deviceName << std::endl;
 }
@@ -160,6 +188,8 @@ void Device::createLogicalDevice()
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
     std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+    if (indices.transferFamilyHasValue)
+        uniqueQueueFamilies.insert(indices.transferFamily);
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -182,7 +212,9 @@ void Device::createLogicalDevice()
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+    // a headless device has no swap chain
+    createInfo.enabledExtensionCount =
+        isHeadless() ? 0 : static_cast<uint32_t>(deviceExtensions.size());
     createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
     // might not really be necessary anymore because device specific validation
@@ -204,6 +236,9 @@ void Device::createLogicalDevice()
 
     vkGetDeviceQueue(device_, indices.graphicsFamily, 0, &graphicsQueue_);
     vkGetDeviceQueue(device_, indices.presentFamily, 0, &presentQueue_);
+    transferQueue_ = graphicsQueue_;
+    if (indices.transferFamilyHasValue)
+        vkGetDeviceQueue(device_, indices.transferFamily, 0, &transferQueue_);
 }
 
 void Device::createCommandPool()
@@ -222,12 +257,18 @@ void Device::createCommandPool()
     }
 }
 
-void Device::createSurface() { window.createWindowSurface(instance, &surface_); }
+void Device::createSurface() { window->createWindowSurface(instance, &surface_); }
 
 bool Device::isDeviceSuitable(VkPhysicalDevice device)
 {
     QueueFamilyIndices indices = findQueueFamilies(device);
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+
+    if (isHeadless())
+        return indices.isComplete() && supportedFeatures.samplerAnisotropy;
+
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
     bool swapChainAdequate = false;
@@ -238,9 +279,6 @@ bool Device::isDeviceSuitable(VkPhysicalDevice device)
             !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
 
-    VkPhysicalDeviceFeatures supportedFeatures;
-    vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
-
     return indices.isComplete() && extensionsSupported && swapChainAdequate &&
         supportedFeatures.samplerAnisotropy;
 }
@@ -302,11 +340,14 @@ bool Device::checkDebugLayerSupport()
 
 std::vector<const char *> Device::getRequiredExtensions()
 {
-    uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-    std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    std::vector<const char *> extensions;
+    if (!isHeadless()) // glfw is not initialized without a window
+    {
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+    }
 
     if (enableDebugLayers)
     {
@@ -380,8 +421,10 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device)
             indices.graphicsFamily = i;
             indices.graphicsFamilyHasValue = true;
         }
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
+        // without a surface the present queue is the graphics queue, it is never presented to
+        VkBool32 presentSupport = isHeadless() && indices.graphicsFamilyHasValue;
+        if (!isHeadless())
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
         if (queueFamily.queueCount > 0 && presentSupport)
         {
             indices.presentFamily = i;
@@ -395,6 +438,22 @@ QueueFamilyIndices Device::findQueueFamilies(VkPhysicalDevice device)
         i++;
     }
 
+    // prefer a pure transfer family, usually dma engines, over an async compute family
+    for (uint32_t family = 0; family < queueFamilyCount; family++)
+    {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (queueFamilies[family].queueCount == 0 || !(flags & VK_QUEUE_TRANSFER_BIT) ||
+            (flags & VK_QUEUE_GRAPHICS_BIT))
+            continue;
+        if (!indices.transferFamilyHasValue || !(flags & VK_QUEUE_COMPUTE_BIT))
+        {
+            indices.transferFamily = family;
+            indices.transferFamilyHasValue = true;
+        }
+        if (!(flags & VK_QUEUE_COMPUTE_BIT))
+            break;
+    }
+
     return indices;
 }
 
@@ -447,6 +506,13 @@ VkFormat Device::findSupportedFormat(
     throw std::runtime_error("failed to find supported format!");
 }
 
+VkPhysicalDeviceMemoryProperties Device::getMemoryProperties()
+{
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    return memProperties;
+}
+
 uint32_t Device::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
     VkPhysicalDeviceMemoryProperties memProperties;
@@ -491,9 +557,22 @@ void Device::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(graphicsQueue_, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue_);
+    // waits for these commands only, not for other work on the queue
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    if (vkCreateFence(device_, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create fence!");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        vkQueueSubmit(graphicsQueue_, 1, &submitInfo, fence);
+    }
+    vkWaitForFences(device_, 1, &fence, VK_TRUE, UINT64_MAX);
 
+    vkDestroyFence(device_, fence, nullptr);
     vkFreeCommandBuffers(device_, commandPool, 1, &commandBuffer);
 }
 
@@ -3,11 +3,17 @@
 #include "window.hpp"
 
 // std
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace lve
 {
+class MemoryAllocator;
+class PipelineBuilder;
+class PipelineCache;
+class TransferContext;
 
 struct SwapChainSupportDetails
 {
@@ -22,6 +28,9 @@ struct QueueFamilyIndices
     uint32_t presentFamily;
     bool graphicsFamilyHasValue = false;
     bool presentFamilyHasValue = false;
+    // a family with transfer but without graphics support, if the device has one
+    uint32_t transferFamily;
+    bool transferFamilyHasValue = false;
     bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -35,6 +44,9 @@ public:
 #endif
 
     Device(Window &window);
+    // no window, surface or swap chain, only the graphics queue for compute and transfer work,
+    // e.g. in the headless benchmark
+    Device();
     ~Device();
 
     // Not copyable or movable
@@ -48,6 +60,13 @@ public:
     VkSurfaceKHR surface() { return surface_; }
     VkQueue graphicsQueue() { return graphicsQueue_; }
     VkQueue presentQueue() { return presentQueue_; }
+    // the queue of the transfer only family, the graphics queue without one
+    VkQueue transferQueue() { return transferQueue_; }
+    // the queues are shared by every thread submitting work, lock this around submits and presents
+    std::mutex &getQueueMutex() { return queueMutex; }
+    bool isHeadless() const { return window == nullptr; }
+    const VkPhysicalDeviceProperties &getProperties() const { return properties; }
+    VkPhysicalDeviceMemoryProperties getMemoryProperties();
 
     SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -57,8 +76,16 @@ public:
         VkImageTiling tiling,
         VkFormatFeatureFlags features);
 
+    // blocks until the commands finished, batch uploads in the transfer context instead
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
+    TransferContext &getTransferContext() { return *transferContext; }
+    // buffers and images allocate their memory here
+    MemoryAllocator &getMemoryAllocator() { return *memoryAllocator; }
+    // pass to every vkCreate*Pipelines, loaded from and saved to disk
+    PipelineCache &getPipelineCache() { return *pipelineCache; }
+    // creates pipelines on worker threads
+    PipelineBuilder &getPipelineBuilder() { return *pipelineBuilder; }
 
 private:
     void createInstance();
@@ -81,13 +108,20 @@ private:
     VkInstance instance;
     VkDebugUtilsMessengerEXT debugMessenger;
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    Window &window;
+    Window *window; // null when headless
+    VkPhysicalDeviceProperties properties;
     VkCommandPool commandPool;
 
     VkDevice device_;
-    VkSurfaceKHR surface_;
+    VkSurfaceKHR surface_ = VK_NULL_HANDLE;
     VkQueue graphicsQueue_;
     VkQueue presentQueue_;
+    VkQueue transferQueue_;
+    std::mutex queueMutex;
+    std::unique_ptr<MemoryAllocator> memoryAllocator;
+    std::unique_ptr<TransferContext> transferContext;
+    std::unique_ptr<PipelineCache> pipelineCache;
+    std::unique_ptr<PipelineBuilder> pipelineBuilder;
 
     const std::vector<const char *> debugLayers = {
         "VK_LAYER_KHRONOS_validation"}; // add VK_LAYER_LUNARG_monitor to show
@@ -1,10 +1,14 @@
 #include "frame_manager.hpp"
 
+// lve
+#include "lve/core/transfer_context.hpp"
+
 // std
 #include <array>
 #include <cassert>
 #include <chrono>
 #include <iostream>
+#include <mutex>
 #include <stdexcept>
 #include <thread>
 
@@ -34,7 +38,10 @@ bool FrameManager::recreateSwapChain()
     VkExtent2D swapChainExtent =
         lveSwapChain == nullptr ? VkExtent2D{0, 0} : lveSwapChain->getSwapChainExtent();
 
-    vkDeviceWaitIdle(lveDevice.vkDevice());
+    {
+        std::lock_guard<std::mutex> lock(lveDevice.getQueueMutex());
+        vkDeviceWaitIdle(lveDevice.vkDevice());
+    }
 
     if (lveSwapChain == nullptr)
     {
@@ -123,6 +130,9 @@ void FrameManager::endFrame()
         throw std::runtime_error("failed to record command buffer!");
     }
 
+    // uploads recorded for this frame go to the queue ahead of it
+    lveDevice.getTransferContext().submit();
+
     VkResult result = lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
 
     if (result == VK_ERROR_OUT_OF_DATE_KHR || // The swap chain has become
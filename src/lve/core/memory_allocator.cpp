@@ -0,0 +1,322 @@
+#include "memory_allocator.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+
+// std
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <set>
+#include <stdexcept>
+
+namespace lve
+{
+// block of device memory split by the buddy system
+struct MemoryBlock
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    uint32_t memoryTypeIndex;
+    MemoryAllocator::ResourceTiling tiling;
+    VkDeviceSize size;
+
+    uint32_t allocationCount = 0;
+    VkDeviceSize rangeBytes = 0;
+    VkDeviceSize requestedBytes = 0;
+    // offsets of the free ranges of every order, a range of order k has MIN_RANGE_SIZE << k bytes
+    std::vector<std::set<VkDeviceSize>> freeRanges;
+
+    static VkDeviceSize getRangeSize(uint32_t order)
+    {
+        return MemoryAllocator::MIN_RANGE_SIZE << order;
+    }
+
+    void initRanges()
+    {
+        uint32_t maxOrder = std::countr_zero(size / MemoryAllocator::MIN_RANGE_SIZE);
+        freeRanges.resize(maxOrder + 1);
+        freeRanges[maxOrder].insert(0);
+    }
+
+    // lowest free range of the order, split from a larger one if needed
+    bool allocate(uint32_t order, VkDeviceSize &offset)
+    {
+        uint32_t available = order;
+        while (available < freeRanges.size() && freeRanges[available].empty())
+            available++;
+        if (available == freeRanges.size())
+            return false;
+
+        offset = *freeRanges[available].begin();
+        freeRanges[available].erase(freeRanges[available].begin());
+        // the upper halves of the splits stay free
+        while (available > order)
+        {
+            available--;
+            freeRanges[available].insert(offset + getRangeSize(available));
+        }
+
+        allocationCount++;
+        rangeBytes += getRangeSize(order);
+        return true;
+    }
+
+    // merges the range with its free buddies
+    void free(VkDeviceSize offset, uint32_t order)
+    {
+        allocationCount--;
+        rangeBytes -= getRangeSize(order);
+
+        while (order + 1 < freeRanges.size())
+        {
+            auto buddy = freeRanges[order].find(offset ^ getRangeSize(order));
+            if (buddy == freeRanges[order].end())
+                break;
+            offset = std::min(offset, *buddy);
+            freeRanges[order].erase(buddy);
+            order++;
+        }
+        freeRanges[order].insert(offset);
+    }
+};
+
+MemoryAllocator::MemoryAllocator(Device &device) : lveDevice{device}
+{
+    memoryProperties = lveDevice.getMemoryProperties();
+    nonCoherentAtomSize = std::max<VkDeviceSize>(
+        lveDevice.getProperties().limits.nonCoherentAtomSize, 1);
+    maxDeviceAllocationCount = lveDevice.getProperties().limits.maxMemoryAllocationCount;
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+    for (auto &typePools : pools)
+    {
+        for (auto &pool : typePools)
+        {
+            for (std::unique_ptr<MemoryBlock> &block : pool)
+                freeDeviceMemory(block->memory);
+        }
+    }
+}
+
+MemoryAllocation MemoryAllocator::allocate(
+    const VkMemoryRequirements &requirements,
+    VkMemoryPropertyFlags properties,
+    ResourceTiling tiling)
+{
+    MemoryAllocation allocation{};
+    allocation.size = requirements.size;
+    allocation.memoryTypeIndex =
+        lveDevice.findMemoryType(requirements.memoryTypeBits, properties);
+    const uint32_t type = allocation.memoryTypeIndex;
+
+    // a buddy range starts at a multiple of its size, so a range of at least the alignment is
+    // aligned
+    const VkDeviceSize rangeSize = std::bit_ceil(
+        std::max({requirements.size, requirements.alignment, MIN_RANGE_SIZE}));
+    const VkDeviceSize blockSize = getBlockSize(type);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rangeSize > blockSize / 2)
+    {
+        allocation.memory = allocateDeviceMemory(type, requirements.size, &allocation.mapped);
+        dedicatedCounts[type]++;
+        dedicatedBytes[type] += requirements.size;
+        return allocation;
+    }
+
+    const uint32_t order = std::countr_zero(rangeSize / MIN_RANGE_SIZE);
+    std::vector<std::unique_ptr<MemoryBlock>> &pool = pools[type][tiling];
+    MemoryBlock *block = nullptr;
+    for (std::unique_ptr<MemoryBlock> &candidate : pool)
+    {
+        if (candidate->allocate(order, allocation.offset))
+        {
+            block = candidate.get();
+            break;
+        }
+    }
+    if (block == nullptr)
+    {
+        auto newBlock = std::make_unique<MemoryBlock>();
+        newBlock->memoryTypeIndex = type;
+        newBlock->tiling = tiling;
+        newBlock->size = blockSize;
+        newBlock->memory = allocateDeviceMemory(type, blockSize, &newBlock->mapped);
+        newBlock->initRanges();
+        newBlock->allocate(order, allocation.offset);
+        block = newBlock.get();
+        pool.push_back(std::move(newBlock));
+    }
+
+    block->requestedBytes += requirements.size;
+    allocation.memory = block->memory;
+    allocation.block = block;
+    allocation.order = order;
+    if (block->mapped != nullptr)
+        allocation.mapped = static_cast<char *>(block->mapped) + allocation.offset;
+    return allocation;
+}
+
+void MemoryAllocator::free(MemoryAllocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryBlock *block = allocation.block;
+    if (block == nullptr)
+    {
+        freeDeviceMemory(allocation.memory);
+        dedicatedCounts[allocation.memoryTypeIndex]--;
+        dedicatedBytes[allocation.memoryTypeIndex] -= allocation.size;
+        allocation = {};
+        return;
+    }
+
+    block->free(allocation.offset, allocation.order);
+    block->requestedBytes -= allocation.size;
+    allocation = {};
+    if (block->allocationCount > 0)
+        return;
+
+    // one empty block stays in the pool, so allocating and freeing in a loop does not go to the
+    // driver every time
+    std::vector<std::unique_ptr<MemoryBlock>> &pool = pools[block->memoryTypeIndex][block->tiling];
+    size_t emptyCount = std::count_if(pool.begin(), pool.end(), [](const auto &candidate) {
+        return candidate->allocationCount == 0;
+    });
+    if (emptyCount > 1)
+    {
+        auto it = std::find_if(pool.begin(), pool.end(), [block](const auto &candidate) {
+            return candidate.get() == block;
+        });
+        freeDeviceMemory(block->memory);
+        pool.erase(it);
+    }
+}
+
+VkMappedMemoryRange MemoryAllocator::getMappedRange(
+    const MemoryAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) const
+{
+    VkDeviceSize begin = allocation.offset + offset;
+    VkDeviceSize end = size == VK_WHOLE_SIZE ? allocation.offset + allocation.size : begin + size;
+    begin = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+    end = (end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+
+    VkMappedMemoryRange mappedRange{};
+    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    mappedRange.memory = allocation.memory;
+    mappedRange.offset = begin;
+    // a range stays inside its buddy range, the end of a dedicated allocation need not be a
+    // multiple of the atom size
+    mappedRange.size =
+        allocation.block == nullptr && end >= allocation.size ? VK_WHOLE_SIZE : end - begin;
+    return mappedRange;
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats stats{};
+    stats.deviceAllocationCount = deviceAllocationCount;
+    stats.maxDeviceAllocationCount = maxDeviceAllocationCount;
+
+    for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; type++)
+    {
+        MemoryTypeStats typeStats{};
+        typeStats.memoryTypeIndex = type;
+        typeStats.propertyFlags = memoryProperties.memoryTypes[type].propertyFlags;
+        typeStats.dedicatedCount = dedicatedCounts[type];
+        typeStats.dedicatedBytes = dedicatedBytes[type];
+        for (auto &pool : pools[type])
+        {
+            for (std::unique_ptr<MemoryBlock> &block : pool)
+            {
+                typeStats.blockCount++;
+                typeStats.blockBytes += block->size;
+                typeStats.allocationCount += block->allocationCount;
+                typeStats.rangeBytes += block->rangeBytes;
+                typeStats.requestedBytes += block->requestedBytes;
+            }
+        }
+        if (typeStats.blockCount > 0 || typeStats.dedicatedCount > 0)
+            stats.memoryTypes.push_back(typeStats);
+    }
+    return stats;
+}
+
+void MemoryAllocator::printStats(std::ostream &out)
+{
+    auto mib = [](VkDeviceSize bytes) { return static_cast<double>(bytes) / (1 << 20); };
+
+    Stats stats = getStats();
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1);
+    out << "device memory: " << stats.deviceAllocationCount << " of "
+        << stats.maxDeviceAllocationCount << " allocations" << std::endl;
+    for (const MemoryTypeStats &type : stats.memoryTypes)
+    {
+        out << "  type " << type.memoryTypeIndex
+            << ((type.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) ? " device local" : "")
+            << ((type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? " host visible" : "")
+            << ": " << type.blockCount << " blocks " << mib(type.blockBytes) << " MiB, "
+            << type.allocationCount << " allocations " << mib(type.requestedBytes) << " MiB in "
+            << mib(type.rangeBytes) << " MiB of ranges, " << type.dedicatedCount << " dedicated "
+            << mib(type.dedicatedBytes) << " MiB" << std::endl;
+    }
+    out.flags(flags);
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const
+{
+    // at most an eighth of a small heap, e.g. the host visible device local window
+    const uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    const VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+    VkDeviceSize blockSize = MAX_BLOCK_SIZE;
+    while (blockSize > MIN_RANGE_SIZE * 2 && blockSize * 8 > heapSize)
+        blockSize /= 2;
+    return blockSize;
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(
+    uint32_t memoryTypeIndex, VkDeviceSize size, void **mapped)
+{
+    if (deviceAllocationCount >= maxDeviceAllocationCount)
+    {
+        throw std::runtime_error("device memory allocation count exceeds the device limit!");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(lveDevice.vkDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+    deviceAllocationCount++;
+
+    *mapped = nullptr;
+    if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        if (vkMapMemory(lveDevice.vkDevice(), memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to map device memory!");
+        }
+    }
+    return memory;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory)
+{
+    // mapped memory is unmapped implicitly
+    vkFreeMemory(lveDevice.vkDevice(), memory, nullptr);
+    deviceAllocationCount--;
+}
+} // namespace lve
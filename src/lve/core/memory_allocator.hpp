@@ -0,0 +1,112 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace lve
+{
+class Device;
+struct MemoryBlock;
+
+// device memory of one buffer or image, a range of a shared block or a dedicated allocation
+struct MemoryAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;  // requested size
+    void *mapped = nullptr; // start of the range in host visible memory, mapped for its lifetime
+    uint32_t memoryTypeIndex = 0;
+
+    MemoryBlock *block = nullptr; // null for a dedicated allocation
+    uint32_t order = 0;           // buddy order of the range in its block
+};
+
+/*
+ * Sub-allocates buffers and images from large blocks of device memory instead of one
+ * vkAllocateMemory per resource, which is slow and counts against maxMemoryAllocationCount.
+ *
+ * Every memory type has two pools of blocks, one for linear resources (buffers, linear images) and
+ * one for optimal tiling images, so neighbours in a block never conflict over
+ * bufferImageGranularity. A block is split by the buddy system into power of two ranges of at
+ * least MIN_RANGE_SIZE, a range starts at a multiple of its size, which covers the alignment of
+ * the resource and nonCoherentAtomSize. Resources over half a block get a dedicated allocation.
+ * Host visible memory stays mapped, so every allocation in it comes with a pointer.
+ */
+class MemoryAllocator
+{
+public:
+    enum ResourceTiling
+    {
+        LINEAR,
+        OPTIMAL,
+        TILING_COUNT
+    };
+
+    static constexpr VkDeviceSize MIN_RANGE_SIZE = 256;
+    static constexpr VkDeviceSize MAX_BLOCK_SIZE = 64ull << 20;
+
+    struct MemoryTypeStats
+    {
+        uint32_t memoryTypeIndex;
+        VkMemoryPropertyFlags propertyFlags;
+        uint32_t blockCount;
+        VkDeviceSize blockBytes;
+        uint32_t allocationCount;  // sub-allocations in the blocks
+        VkDeviceSize rangeBytes;   // buddy ranges in use, power of two sizes
+        VkDeviceSize requestedBytes;
+        uint32_t dedicatedCount;
+        VkDeviceSize dedicatedBytes;
+    };
+    struct Stats
+    {
+        std::vector<MemoryTypeStats> memoryTypes; // only the types in use
+        uint32_t deviceAllocationCount;          // vkAllocateMemory calls alive
+        uint32_t maxDeviceAllocationCount;
+    };
+
+    explicit MemoryAllocator(Device &device);
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator &) = delete;
+    MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+    MemoryAllocation allocate(
+        const VkMemoryRequirements &requirements,
+        VkMemoryPropertyFlags properties,
+        ResourceTiling tiling);
+    void free(MemoryAllocation &allocation);
+
+    // range of an allocation for flush and invalidate, widened to nonCoherentAtomSize
+    VkMappedMemoryRange getMappedRange(
+        const MemoryAllocation &allocation, VkDeviceSize size, VkDeviceSize offset) const;
+
+    Stats getStats();
+    void printStats(std::ostream &out);
+
+private:
+    Device &lveDevice;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    VkDeviceSize nonCoherentAtomSize;
+    uint32_t maxDeviceAllocationCount;
+
+    std::mutex mutex;
+    std::array<std::array<std::vector<std::unique_ptr<MemoryBlock>>, TILING_COUNT>,
+               VK_MAX_MEMORY_TYPES>
+        pools;
+    std::array<uint32_t, VK_MAX_MEMORY_TYPES> dedicatedCounts{};
+    std::array<VkDeviceSize, VK_MAX_MEMORY_TYPES> dedicatedBytes{};
+    uint32_t deviceAllocationCount = 0;
+
+    VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+    VkDeviceMemory allocateDeviceMemory(uint32_t memoryTypeIndex, VkDeviceSize size, void **mapped);
+    void freeDeviceMemory(VkDeviceMemory memory);
+};
+} // namespace lve
@@ -2,12 +2,14 @@
 
 // lve
 #include "lve/GO/geo/model.hpp"
+#include "lve/core/pipeline/pipeline_cache.hpp"
 #include "lve/path.hpp"
 #include "lve/util/config.hpp"
 #include "lve/util/file_io.hpp"
 
 // std
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -17,10 +19,11 @@ namespace lve
 ComputePipeline::ComputePipeline(
     Device &device,
     const std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
-    const std::string &compFilePath)
+    const std::string &compFilePath,
+    const std::vector<VkPushConstantRange> &pushConstantRanges)
     : Pipeline(device)
 {
-    createPipelineLayout(descriptorSetLayouts);
+    createPipelineLayout(descriptorSetLayouts, pushConstantRanges);
     createPipeline(compFilePath);
     initialized = true;
 }
@@ -45,19 +48,28 @@ void ComputePipeline::dispatchComputePipeline(
     vkCmdDispatch(cmdBuffer, width, height, 1);
 }
 
+void ComputePipeline::pushConstants(
+    VkCommandBuffer cmdBuffer, const void *data, uint32_t size, uint32_t offset)
+{
+    vkCmdPushConstants(
+        cmdBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, data);
+}
+
 void ComputePipeline::bind(VkCommandBuffer commandBuffer)
 {
     vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 }
 
-void ComputePipeline::createPipelineLayout(std::vector<VkDescriptorSetLayout> descriptorSetLayouts)
+void ComputePipeline::createPipelineLayout(
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
+    const std::vector<VkPushConstantRange> &pushConstantRanges)
 {
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
     pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
-    pipelineLayoutInfo.pushConstantRangeCount = 0;
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
+    pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size());
+    pipelineLayoutInfo.pPushConstantRanges = pushConstantRanges.data();
 
     if (vkCreatePipelineLayout(
             lveDevice.vkDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
@@ -89,11 +101,18 @@ void ComputePipeline::createPipeline(const std::string &compFilePath)
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex = -1;
 
+    PipelineCache &pipelineCache = lveDevice.getPipelineCache();
+    auto createStart = std::chrono::steady_clock::now();
     if (vkCreateComputePipelines(
-            lveDevice.vkDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) !=
-        VK_SUCCESS)
+            lveDevice.vkDevice(),
+            pipelineCache.getCache(),
+            1,
+            &pipelineInfo,
+            nullptr,
+            &pipeline) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create compute pipeline");
     }
+    pipelineCache.addCreationTime(std::chrono::steady_clock::now() - createStart);
 }
 } // namespace lve
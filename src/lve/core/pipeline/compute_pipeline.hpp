@@ -17,18 +17,24 @@ public:
     ComputePipeline(
         Device &device,
         const std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
-        const std::string &compFilePath);
+        const std::string &compFilePath,
+        const std::vector<VkPushConstantRange> &pushConstantRanges = {});
 
     void dispatchComputePipeline(
         VkCommandBuffer cmdBuffer,
         const VkDescriptorSet *pGlobalDescriptorSet,
         uint32_t width,
         uint32_t height);
+    // record before dispatching, every range of the layout is in the compute stage
+    void pushConstants(
+        VkCommandBuffer cmdBuffer, const void *data, uint32_t size, uint32_t offset = 0);
 
     void bind(VkCommandBuffer commandBuffer) override;
 
 private:
-    void createPipelineLayout(std::vector<VkDescriptorSetLayout> descriptorSetLayouts);
+    void createPipelineLayout(
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts,
+        const std::vector<VkPushConstantRange> &pushConstantRanges);
     void createPipeline(const std::string &compFilePath);
 };
 } // namespace lve
@@ -2,12 +2,14 @@
 
 // lve
 #include "lve/GO/geo/model.hpp"
+#include "lve/core/pipeline/pipeline_cache.hpp"
 #include "lve/path.hpp"
 #include "lve/util/config.hpp"
 #include "lve/util/file_io.hpp"
 
 // std
 #include <cassert>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
@@ -209,12 +211,19 @@ void GraphicPipeline::createGraphicsPipeline(const GraphicPipelineConfigInfo &pi
     pipelineInfo.basePipelineIndex = -1;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
+    PipelineCache &pipelineCache = lveDevice.getPipelineCache();
+    auto createStart = std::chrono::steady_clock::now();
     if (vkCreateGraphicsPipelines(
-            lveDevice.vkDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) !=
-        VK_SUCCESS)
+            lveDevice.vkDevice(),
+            pipelineCache.getCache(),
+            1,
+            &pipelineInfo,
+            nullptr,
+            &pipeline) != VK_SUCCESS)
     {
         throw std::runtime_error("failed to create graphics pipeline");
     }
+    pipelineCache.addCreationTime(std::chrono::steady_clock::now() - createStart);
 }
 
 void renderGameObjects(
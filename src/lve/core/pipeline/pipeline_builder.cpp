@@ -0,0 +1,105 @@
+#include "pipeline_builder.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+
+// std
+#include <algorithm>
+#include <type_traits>
+
+namespace lve
+{
+PipelineBuilder::PipelineBuilder(Device &device) : lveDevice{device}
+{
+    uint32_t workerCount = std::clamp(std::thread::hardware_concurrency(), 1u, MAX_WORKER_COUNT);
+    for (uint32_t i = 0; i < workerCount; i++)
+        workers.emplace_back(&PipelineBuilder::workerLoop, this);
+}
+
+PipelineBuilder::~PipelineBuilder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+std::future<std::unique_ptr<GraphicPipeline>> PipelineBuilder::build(
+    GraphicPipelineDescription description)
+{
+    // the config info is move only, shared to keep the callable copyable
+    auto sharedDescription = std::make_shared<GraphicPipelineDescription>(std::move(description));
+    return enqueue([this, sharedDescription]() {
+        return std::make_unique<GraphicPipeline>(
+            lveDevice, sharedDescription->layoutConfigInfo, *sharedDescription->configInfo);
+    });
+}
+
+std::future<std::unique_ptr<ComputePipeline>> PipelineBuilder::build(
+    ComputePipelineDescription description)
+{
+    return enqueue([this, description = std::move(description)]() {
+        return std::make_unique<ComputePipeline>(
+            lveDevice,
+            description.descriptorSetLayouts,
+            description.compFilePath,
+            description.pushConstantRanges);
+    });
+}
+
+std::vector<std::future<std::unique_ptr<GraphicPipeline>>> PipelineBuilder::build(
+    std::vector<GraphicPipelineDescription> descriptions)
+{
+    std::vector<std::future<std::unique_ptr<GraphicPipeline>>> futures;
+    for (GraphicPipelineDescription &description : descriptions)
+        futures.push_back(build(std::move(description)));
+    return futures;
+}
+
+std::vector<std::future<std::unique_ptr<ComputePipeline>>> PipelineBuilder::build(
+    std::vector<ComputePipelineDescription> descriptions)
+{
+    std::vector<std::future<std::unique_ptr<ComputePipeline>>> futures;
+    for (ComputePipelineDescription &description : descriptions)
+        futures.push_back(build(std::move(description)));
+    return futures;
+}
+
+template <typename F>
+std::future<std::invoke_result_t<F>> PipelineBuilder::enqueue(F create)
+{
+    // MSVC keeps the callable of a packaged_task in a std::function, which needs a copyable one
+    static_assert(std::is_copy_constructible_v<F>, "pipeline build callables must be copyable");
+
+    // the task itself is only moved, shared to go into the std::function of the queue
+    auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::move(create));
+    std::future<std::invoke_result_t<F>> future = task->get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.emplace_back([task]() { (*task)(); });
+    }
+    taskAvailable.notify_one();
+    return future;
+}
+
+void PipelineBuilder::workerLoop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        // exceptions end up in the future
+        task();
+    }
+}
+} // namespace lve
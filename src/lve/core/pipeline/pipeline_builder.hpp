@@ -0,0 +1,81 @@
+#pragma once
+
+// lve
+#include "lve/core/pipeline/compute_pipeline.hpp"
+#include "lve/core/pipeline/graphics_pipeline.hpp"
+
+// std
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lve
+{
+class Device;
+
+struct GraphicPipelineDescription
+{
+    GraphicPipelineLayoutConfigInfo layoutConfigInfo;
+    // not copyable, it points into itself
+    std::unique_ptr<GraphicPipelineConfigInfo> configInfo;
+};
+
+struct ComputePipelineDescription
+{
+    std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+    std::string compFilePath;
+    std::vector<VkPushConstantRange> pushConstantRanges;
+};
+
+/*
+ * Creates pipelines on a pool of worker threads, one per core, instead of on the thread that
+ * needs them. Reading the SPIR-V, creating the shader modules and compiling the pipeline all
+ * happen on a worker, build returns right away with a future of the pipeline, so several
+ * pipelines compile at once and the caller can go on with other setup until it needs one.
+ *
+ * The render passes and descriptor set layouts of the descriptions must outlive the build. A
+ * failed build rethrows its exception from the future. Every pipeline goes through the pipeline
+ * cache of the device.
+ */
+class PipelineBuilder
+{
+public:
+    static constexpr uint32_t MAX_WORKER_COUNT = 8;
+
+    explicit PipelineBuilder(Device &device);
+    ~PipelineBuilder(); // finishes the queued builds
+
+    PipelineBuilder(const PipelineBuilder &) = delete;
+    PipelineBuilder &operator=(const PipelineBuilder &) = delete;
+
+    std::future<std::unique_ptr<GraphicPipeline>> build(GraphicPipelineDescription description);
+    std::future<std::unique_ptr<ComputePipeline>> build(ComputePipelineDescription description);
+    // the futures are in the order of the descriptions
+    std::vector<std::future<std::unique_ptr<GraphicPipeline>>> build(
+        std::vector<GraphicPipelineDescription> descriptions);
+    std::vector<std::future<std::unique_ptr<ComputePipeline>>> build(
+        std::vector<ComputePipelineDescription> descriptions);
+
+    uint32_t getWorkerCount() const { return static_cast<uint32_t>(workers.size()); }
+
+private:
+    Device &lveDevice;
+
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::deque<std::function<void()>> tasks;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+    template <typename F>
+    std::future<std::invoke_result_t<F>> enqueue(F create);
+    void workerLoop();
+};
+} // namespace lve
@@ -0,0 +1,129 @@
+#include "pipeline_cache.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+#include "lve/util/file_io.hpp"
+
+// std
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace lve
+{
+PipelineCache::PipelineCache(Device &device, const std::string &directory) : lveDevice{device}
+{
+    const VkPhysicalDeviceProperties &properties = lveDevice.getProperties();
+    std::ostringstream fileName;
+    fileName << std::hex << std::setfill('0') << "pipeline_" << std::setw(4)
+             << properties.vendorID << "_" << std::setw(4) << properties.deviceID << "_";
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+        fileName << std::setw(2) << static_cast<uint32_t>(properties.pipelineCacheUUID[i]);
+    fileName << ".bin";
+    filePath = directory + fileName.str();
+
+    std::vector<char> data;
+    if (std::filesystem::exists(filePath))
+    {
+        io::readBinaryFile(filePath, data);
+        if (!isCompatible(data))
+        {
+            std::cerr << "pipeline cache: ignoring " << filePath << ", it is from another device"
+                      << std::endl;
+            data.clear();
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(lveDevice.vkDevice(), &createInfo, nullptr, &cache) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+    loadedSize = data.size();
+}
+
+PipelineCache::~PipelineCache()
+{
+    // a failed write only costs the next start its warm cache
+    try
+    {
+        save();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "pipeline cache: " << e.what() << std::endl;
+    }
+    vkDestroyPipelineCache(lveDevice.vkDevice(), cache, nullptr);
+}
+
+void PipelineCache::addCreationTime(std::chrono::steady_clock::duration duration)
+{
+    pipelineCount++;
+    creationNanoseconds +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+void PipelineCache::printStats(std::ostream &out) const
+{
+    std::ios_base::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(1) << "pipeline cache: "
+        << (isWarm() ? "warm, " + std::to_string(loadedSize / 1024) + " KiB loaded" : "cold")
+        << ", " << pipelineCount << " pipelines created in " << creationNanoseconds / 1e6 << " ms"
+        << std::endl;
+    out.flags(flags);
+}
+
+void PipelineCache::save()
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(lveDevice.vkDevice(), cache, &dataSize, nullptr) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to get pipeline cache size!");
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(lveDevice.vkDevice(), cache, &dataSize, data.data()) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to get pipeline cache data!");
+    }
+    data.resize(dataSize);
+
+    // readers only ever see the old or the new file
+    std::filesystem::path path(filePath);
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path());
+    std::string tempPath = filePath + ".tmp";
+    io::writeFile(tempPath, data);
+    std::filesystem::rename(tempPath, filePath);
+}
+
+bool PipelineCache::isCompatible(const std::vector<char> &data) const
+{
+    // VkPipelineCacheHeaderVersionOne
+    struct Header
+    {
+        uint32_t headerSize;
+        uint32_t headerVersion;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    };
+    if (data.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, data.data(), sizeof(Header));
+    const VkPhysicalDeviceProperties &properties = lveDevice.getProperties();
+    return header.headerSize >= sizeof(Header) &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+           std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+} // namespace lve
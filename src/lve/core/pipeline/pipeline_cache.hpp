@@ -0,0 +1,57 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+class Device;
+
+/*
+ * VkPipelineCache shared by every pipeline of a device and kept on disk between runs, so a warm
+ * start does not compile the shaders of every pipeline again.
+ *
+ * The file is named after the vendor, device and pipelineCacheUUID of the physical device, a
+ * driver update changes the UUID and starts a new file. A file whose header does not match the
+ * device is ignored. The cache is written back when it is destroyed, to a temporary file renamed
+ * over the old one, so a crash while writing never leaves a truncated cache behind.
+ */
+class PipelineCache
+{
+public:
+    PipelineCache(Device &device, const std::string &directory);
+    ~PipelineCache();
+
+    PipelineCache(const PipelineCache &) = delete;
+    PipelineCache &operator=(const PipelineCache &) = delete;
+
+    VkPipelineCache getCache() const { return cache; }
+    bool isWarm() const { return loadedSize > 0; }
+
+    // pipelines report how long their vkCreate*Pipelines took, from any thread
+    void addCreationTime(std::chrono::steady_clock::duration duration);
+    // warm or cold start and the time spent creating pipelines so far
+    void printStats(std::ostream &out) const;
+
+    void save();
+
+private:
+    Device &lveDevice;
+    std::string filePath;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    size_t loadedSize = 0;
+
+    std::atomic<uint32_t> pipelineCount{0};
+    std::atomic<int64_t> creationNanoseconds{0};
+
+    bool isCompatible(const std::vector<char> &data) const;
+};
+} // namespace lve
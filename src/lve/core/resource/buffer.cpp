@@ -7,6 +7,9 @@
 
 #include "buffer.hpp"
 
+// lve
+#include "lve/core/transfer_context.hpp"
+
 // std
 #include <cassert>
 #include <cstring>
@@ -56,7 +59,7 @@ Buffer::~Buffer()
 {
     unmap();
     vkDestroyBuffer(lveDevice.vkDevice(), buffer, nullptr);
-    vkFreeMemory(lveDevice.vkDevice(), memory, nullptr);
+    lveDevice.getMemoryAllocator().free(memory);
 }
 
 void Buffer::createBuffer(
@@ -64,7 +67,7 @@ void Buffer::createBuffer(
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
     VkBuffer &buffer,
-    VkDeviceMemory &bufferMemory)
+    MemoryAllocation &bufferMemory)
 {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -80,23 +83,16 @@ void Buffer::createBuffer(
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(lveDevice.vkDevice(), buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex =
-        lveDevice.findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(lveDevice.vkDevice(), &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
-    }
+    bufferMemory = lveDevice.getMemoryAllocator().allocate(
+        memRequirements, properties, MemoryAllocator::LINEAR);
 
-    vkBindBufferMemory(lveDevice.vkDevice(), buffer, bufferMemory, 0);
+    vkBindBufferMemory(lveDevice.vkDevice(), buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the
- * specified buffer range.
+ * specified buffer range. Host visible memory stays mapped by the memory
+ * allocator, this only points into it.
  *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to
  * map the complete buffer range.
@@ -106,37 +102,30 @@ void Buffer::createBuffer(
  */
 VkResult Buffer::map(VkDeviceSize size, VkDeviceSize offset)
 {
-    assert(buffer && memory && "Called map on buffer before create");
-    return vkMapMemory(lveDevice.vkDevice(), memory, offset, size, 0, &mapped);
+    assert(buffer && memory.memory && "Called map on buffer before create");
+    if (memory.mapped == nullptr)
+    {
+        return VK_ERROR_MEMORY_MAP_FAILED;
+    }
+    mapped = static_cast<char *>(memory.mapped) + offset;
+    return VK_SUCCESS;
 }
 
 /**
- * Unmap a mapped memory range
- *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * Unmap a mapped memory range, the memory itself stays mapped for the other
+ * resources in its block
  */
-void Buffer::unmap()
-{
-    if (mapped)
-    {
-        vkUnmapMemory(lveDevice.vkDevice(), memory);
-        mapped = nullptr;
-    }
-}
+void Buffer::unmap() { mapped = nullptr; }
 
 void Buffer::copyBufferFrom(VkBuffer srcBuffer, VkDeviceSize size)
 {
-    VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    /* Optional
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    */
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, buffer, 1, &copyRegion);
+    TransferContext &transferContext = lveDevice.getTransferContext();
+    transferContext.wait(transferContext.copyBuffer(srcBuffer, buffer, size));
+}
 
-    lveDevice.endSingleTimeCommands(commandBuffer);
+uint64_t Buffer::recordCopyFrom(VkBuffer srcBuffer, VkDeviceSize size)
+{
+    return lveDevice.getTransferContext().copyBuffer(srcBuffer, buffer, size);
 }
 
 /**
@@ -178,11 +167,8 @@ void Buffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset)
  */
 VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
 {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
+    VkMappedMemoryRange mappedRange =
+        lveDevice.getMemoryAllocator().getMappedRange(memory, size, offset);
     return vkFlushMappedMemoryRanges(lveDevice.vkDevice(), 1, &mappedRange);
 }
 
@@ -199,11 +185,8 @@ VkResult Buffer::flush(VkDeviceSize size, VkDeviceSize offset)
  */
 VkResult Buffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 {
-    VkMappedMemoryRange mappedRange = {};
-    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = offset;
-    mappedRange.size = size;
+    VkMappedMemoryRange mappedRange =
+        lveDevice.getMemoryAllocator().getMappedRange(memory, size, offset);
     return vkInvalidateMappedMemoryRanges(lveDevice.vkDevice(), 1, &mappedRange);
 }
 
@@ -2,6 +2,7 @@
 
 // lve
 #include "lve/core/device.hpp"
+#include "lve/core/memory_allocator.hpp"
 
 namespace lve
 {
@@ -26,12 +27,15 @@ public:
         VkBufferUsageFlags usage,
         VkMemoryPropertyFlags properties,
         VkBuffer &buffer,
-        VkDeviceMemory &bufferMemory);
+        MemoryAllocation &bufferMemory);
 
     VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     void unmap();
 
+    // copies through the transfer context of the device and waits for the copy
     void copyBufferFrom(VkBuffer srcBuffer, VkDeviceSize size);
+    // records the copy into the open transfer batch and returns its ticket without waiting
+    uint64_t recordCopyFrom(VkBuffer srcBuffer, VkDeviceSize size);
     void writeToBuffer(void *data, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
     VkDescriptorBufferInfo
@@ -62,7 +66,7 @@ private:
     Device &lveDevice;
     void *mapped = nullptr;
     VkBuffer buffer = VK_NULL_HANDLE;
-    VkDeviceMemory memory = VK_NULL_HANDLE;
+    MemoryAllocation memory; // from the memory allocator of the device
 
     uint64_t recordedOffset = 0;
 
@@ -0,0 +1,33 @@
+#include "frame_vertex_ring.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve
+{
+FrameVertexRing::FrameVertexRing(Device &device, VkDeviceSize vertexSize, uint32_t maxVertexCount)
+    : maxVertexCount{maxVertexCount}
+{
+    for (std::unique_ptr<Buffer> &buffer : buffers)
+    {
+        // a buffer of size 0 is not valid, an empty ring still gets one vertex
+        buffer = std::make_unique<Buffer>(
+            device,
+            vertexSize,
+            std::max(maxVertexCount, 1u),
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        if (buffer->map() != VK_SUCCESS)
+            throw std::runtime_error("failed to map frame vertex buffer!");
+    }
+}
+
+void FrameVertexRing::bind(VkCommandBuffer commandBuffer, int frameIndex, uint32_t binding) const
+{
+    VkBuffer vertexBuffers[] = {buffers[frameIndex]->getBuffer()};
+    VkDeviceSize offsets[] = {0};
+    vkCmdBindVertexBuffers(commandBuffer, binding, 1, vertexBuffers, offsets);
+}
+} // namespace lve
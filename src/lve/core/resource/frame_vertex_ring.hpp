@@ -0,0 +1,46 @@
+#pragma once
+
+// lve
+#include "lve/core/device.hpp"
+#include "lve/core/resource/buffer.hpp"
+#include "lve/core/swap_chain.hpp"
+
+// std
+#include <array>
+#include <cstdint>
+#include <memory>
+
+namespace lve
+{
+/*
+ * Host visible vertex buffers, one per frame in flight, mapped for their whole lifetime. The host
+ * writes the vertices of a frame straight into the buffer of its frame index, the device reads
+ * them from there, so there is no staging copy and no queue submission for the upload.
+ *
+ * The buffer of a frame index is free to write once FrameManager::beginFrame returned for it, the
+ * swap chain waited for the fence of the frame that last read it.
+ */
+class FrameVertexRing
+{
+public:
+    FrameVertexRing(Device &device, VkDeviceSize vertexSize, uint32_t maxVertexCount);
+
+    FrameVertexRing(const FrameVertexRing &) = delete;
+    FrameVertexRing &operator=(const FrameVertexRing &) = delete;
+
+    // mapped memory of the buffer of frameIndex, room for maxVertexCount vertices
+    void *getMappedMemory(int frameIndex) const { return buffers[frameIndex]->getMappedMemory(); }
+    template <typename T> T *getVertices(int frameIndex) const
+    {
+        return static_cast<T *>(getMappedMemory(frameIndex));
+    }
+
+    void bind(VkCommandBuffer commandBuffer, int frameIndex, uint32_t binding = 0) const;
+
+    uint32_t getMaxVertexCount() const { return maxVertexCount; }
+
+private:
+    uint32_t maxVertexCount;
+    std::array<std::unique_ptr<Buffer>, SwapChain::MAX_FRAMES_IN_FLIGHT> buffers;
+};
+} // namespace lve
@@ -1,5 +1,8 @@
 #include "image.hpp"
 
+// lve
+#include "lve/core/transfer_context.hpp"
+
 // std
 #include <stdexcept>
 
@@ -19,7 +22,7 @@ Image::Image(
         throw std::runtime_error("Failed to create image");
     }
 
-    allocateMemory(memPropertyFlags);
+    allocateMemory(memPropertyFlags, imageCreateInfo.tiling);
 
     initialized = true;
 
@@ -41,7 +44,7 @@ Image::Image(Image &&other)
       initialized{other.initialized}
 {
     other.image = nullptr;
-    other.imageMemory = nullptr;
+    other.imageMemory = {};
 }
 
 Image &Image::operator=(Image &&other)
@@ -65,7 +68,7 @@ Image &Image::operator=(Image &&other)
 
         // Reset other object
         other.image = nullptr;
-        other.imageMemory = nullptr;
+        other.imageMemory = {};
     }
 
     return *this;
@@ -112,34 +115,10 @@ void Image::convertLayout(VkImageLayout newLayout)
         throw std::runtime_error("Image must be initialized before converting layout");
     }
 
-    VkCommandBuffer commandBuffer = lveDevice.beginSingleTimeCommands();
-
-    VkImageMemoryBarrier imageMemoryBarrier{};
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageMemoryBarrier.newLayout = newLayout;
-    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    imageMemoryBarrier.image = image;
-    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
-    imageMemoryBarrier.subresourceRange.levelCount = 1;
-    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
-    imageMemoryBarrier.subresourceRange.layerCount = 1;
-
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-        0,
-        0,
-        nullptr,
-        0,
-        nullptr,
-        1,
-        &imageMemoryBarrier);
-
-    lveDevice.endSingleTimeCommands(commandBuffer);
+    // the layout has changed when this returns, as with the former single time commands, so
+    // callers may use the image in the new layout in any later submission
+    TransferContext &transferContext = lveDevice.getTransferContext();
+    transferContext.wait(transferContext.transitionImageLayout(image, imageLayout, newLayout));
 
     imageLayout = newLayout;
 }
@@ -150,24 +129,19 @@ VkDescriptorImageInfo Image::getDescriptorImageInfo(int imageViewId, VkSampler s
         .sampler = sampler, .imageView = getImageView(imageViewId), .imageLayout = imageLayout};
 }
 
-void Image::allocateMemory(VkMemoryPropertyFlags memPropertyFlags)
+void Image::allocateMemory(VkMemoryPropertyFlags memPropertyFlags, VkImageTiling tiling)
 {
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(lveDevice.vkDevice(), image, &memoryRequirements);
 
-    VkMemoryAllocateInfo memoryAllocateInfo{};
-    memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex =
-        lveDevice.findMemoryType(memoryRequirements.memoryTypeBits, memPropertyFlags);
-
-    if (vkAllocateMemory(lveDevice.vkDevice(), &memoryAllocateInfo, nullptr, &imageMemory) !=
-        VK_SUCCESS)
-    {
-        throw std::runtime_error("Failed to allocate image memory");
-    }
+    // linear images may share a block with buffers, optimal ones are kept apart from both for
+    // bufferImageGranularity
+    imageMemory = lveDevice.getMemoryAllocator().allocate(
+        memoryRequirements,
+        memPropertyFlags,
+        tiling == VK_IMAGE_TILING_LINEAR ? MemoryAllocator::LINEAR : MemoryAllocator::OPTIMAL);
 
-    vkBindImageMemory(lveDevice.vkDevice(), image, imageMemory, 0);
+    vkBindImageMemory(lveDevice.vkDevice(), image, imageMemory.memory, imageMemory.offset);
 }
 
 void Image::cleanUp()
@@ -182,6 +156,6 @@ void Image::cleanUp()
         vkDestroyImageView(lveDevice.vkDevice(), imageView.second, nullptr);
     }
     vkDestroyImage(lveDevice.vkDevice(), image, nullptr);
-    vkFreeMemory(lveDevice.vkDevice(), imageMemory, nullptr);
+    lveDevice.getMemoryAllocator().free(imageMemory);
 }
 } // namespace lve
\ No newline at end of file
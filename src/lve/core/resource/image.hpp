@@ -2,6 +2,7 @@
 
 // lve
 #include "lve/core/device.hpp"
+#include "lve/core/memory_allocator.hpp"
 
 // libs
 #include <vulkan/vulkan.h>
@@ -32,6 +33,7 @@ public:
 
     VkImageView getImageView(int id) const;
 
+    // blocks until the transition ran on the graphics queue
     void convertLayout(VkImageLayout newLayout);
 
     VkImage getImage() const { return image; }
@@ -41,12 +43,12 @@ public:
     VkDescriptorImageInfo getDescriptorImageInfo(int imageViewId, VkSampler sampler) const;
 
 private:
-    void allocateMemory(VkMemoryPropertyFlags memPropertyFlags);
+    void allocateMemory(VkMemoryPropertyFlags memPropertyFlags, VkImageTiling tiling);
 
     void cleanUp();
 
     Device &lveDevice;
-    VkDeviceMemory imageMemory;
+    MemoryAllocation imageMemory; // from the memory allocator of the device
     VkImage image;
     VkExtent3D extent;
     std::unordered_map<int, VkImageView> imageViews;
@@ -0,0 +1,537 @@
+#include "transfer_context.hpp"
+
+// lve
+#include "lve/core/device.hpp"
+
+// std
+#include <algorithm>
+#include <stdexcept>
+
+namespace lve
+{
+TransferContext::TransferContext(Device &device) : lveDevice{device}
+{
+    QueueFamilyIndices indices = lveDevice.findPhysicalQueueFamilies();
+    graphicsFamily = indices.graphicsFamily;
+    dedicatedQueue = indices.transferFamilyHasValue;
+    transferFamily = dedicatedQueue ? indices.transferFamily : indices.graphicsFamily;
+
+    graphicsCommandPool = createCommandPool(graphicsFamily);
+    if (dedicatedQueue)
+        transferCommandPool = createCommandPool(transferFamily);
+}
+
+TransferContext::~TransferContext()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (std::unique_ptr<Batch> &batch : submittedBatches)
+    {
+        vkWaitForFences(lveDevice.vkDevice(), 1, &batch->fence, VK_TRUE, UINT64_MAX);
+        destroyBatch(*batch);
+    }
+    for (std::unique_ptr<Batch> &batch : freeBatches)
+        destroyBatch(*batch);
+    if (openBatch)
+        destroyBatch(*openBatch);
+
+    vkDestroyCommandPool(lveDevice.vkDevice(), graphicsCommandPool, nullptr);
+    if (transferCommandPool != VK_NULL_HANDLE)
+        vkDestroyCommandPool(lveDevice.vkDevice(), transferCommandPool, nullptr);
+}
+
+uint64_t TransferContext::copyBuffer(
+    VkBuffer srcBuffer,
+    VkBuffer dstBuffer,
+    VkDeviceSize size,
+    VkDeviceSize srcOffset,
+    VkDeviceSize dstOffset)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Batch &batch = getOpenBatch();
+
+    // the sources are only read when the batch runs, so a copy between the same offsets again,
+    // e.g. a collection updated twice in a frame, extends the earlier one instead of racing it
+    for (BufferCopy &copy : batch.copies)
+    {
+        if (copy.srcBuffer == srcBuffer && copy.dstBuffer == dstBuffer &&
+            copy.region.srcOffset == srcOffset && copy.region.dstOffset == dstOffset)
+        {
+            copy.region.size = std::max(copy.region.size, size);
+            return batch.ticket;
+        }
+    }
+    batch.copies.push_back({srcBuffer, dstBuffer, VkBufferCopy{srcOffset, dstOffset, size}});
+    return batch.ticket;
+}
+
+uint64_t TransferContext::transitionImageLayout(
+    VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+    VkImageMemoryBarrier imageMemoryBarrier{};
+    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    imageMemoryBarrier.oldLayout = oldLayout;
+    imageMemoryBarrier.newLayout = newLayout;
+    imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    imageMemoryBarrier.image = image;
+    imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    imageMemoryBarrier.subresourceRange.baseMipLevel = 0;
+    imageMemoryBarrier.subresourceRange.levelCount = 1;
+    imageMemoryBarrier.subresourceRange.baseArrayLayer = 0;
+    imageMemoryBarrier.subresourceRange.layerCount = 1;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    Batch &batch = getOpenBatch();
+    batch.imageBarriers.push_back(imageMemoryBarrier);
+    return batch.ticket;
+}
+
+uint64_t TransferContext::submit()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    sourceWritesDone.wait(
+        lock, [this]() { return !openBatch || openBatch->sourceWriterCount == 0; });
+    return submitOpenBatch();
+}
+
+void TransferContext::wait(uint64_t ticket)
+{
+    if (ticket == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    sourceWritesDone.wait(lock, [this, ticket]() {
+        return !openBatch || openBatch->ticket != ticket || openBatch->sourceWriterCount == 0;
+    });
+    if (openBatch && openBatch->ticket == ticket)
+        submitOpenBatch();
+    waitForBatch(lock, ticket);
+}
+
+TransferContext::SourceWriteGuard TransferContext::beginSourceWrite(uint64_t ticket)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (ticket != 0 && openBatch && openBatch->ticket == ticket)
+    {
+        openBatch->sourceWriterCount++;
+        return SourceWriteGuard(this);
+    }
+    waitForBatch(lock, ticket);
+    return SourceWriteGuard();
+}
+
+void TransferContext::endSourceWrite()
+{
+    {
+        // submission waits for the guards, so the batch they hold off is still the open one
+        std::lock_guard<std::mutex> lock(mutex);
+        openBatch->sourceWriterCount--;
+    }
+    sourceWritesDone.notify_all();
+}
+
+TransferContext::SourceWriteGuard &TransferContext::SourceWriteGuard::operator=(
+    SourceWriteGuard &&other)
+{
+    if (this != &other)
+    {
+        release();
+        context = other.context;
+        other.context = nullptr;
+    }
+    return *this;
+}
+
+void TransferContext::SourceWriteGuard::release()
+{
+    if (context != nullptr)
+    {
+        context->endSourceWrite();
+        context = nullptr;
+    }
+}
+
+void TransferContext::waitForBatch(std::unique_lock<std::mutex> &lock, uint64_t ticket)
+{
+    auto it = std::find_if(
+        submittedBatches.begin(), submittedBatches.end(), [ticket](const auto &batch) {
+            return batch->ticket == ticket;
+        });
+    // not submitted batches are retired already
+    if (it != submittedBatches.end())
+    {
+        // the batch is not retired while it has waiters, so it and its fence stay valid while
+        // other threads record and submit
+        Batch &batch = **it;
+        batch.waiterCount++;
+        VkFence fence = batch.fence;
+        lock.unlock();
+        vkWaitForFences(lveDevice.vkDevice(), 1, &fence, VK_TRUE, UINT64_MAX);
+        lock.lock();
+        batch.waiterCount--;
+    }
+    retireFinishedBatches();
+}
+
+VkCommandPool TransferContext::createCommandPool(uint32_t queueFamily)
+{
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamily;
+    poolInfo.flags =
+        VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+    VkCommandPool commandPool;
+    if (vkCreateCommandPool(lveDevice.vkDevice(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create transfer command pool!");
+    }
+    return commandPool;
+}
+
+std::unique_ptr<TransferContext::Batch> TransferContext::createBatch()
+{
+    auto batch = std::make_unique<Batch>();
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = graphicsCommandPool;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(lveDevice.vkDevice(), &allocInfo, &batch->graphicsCommands) !=
+        VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to allocate transfer command buffer!");
+    }
+
+    if (dedicatedQueue)
+    {
+        if (vkAllocateCommandBuffers(lveDevice.vkDevice(), &allocInfo, &batch->releaseCommands) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate transfer command buffer!");
+        }
+        allocInfo.commandPool = transferCommandPool;
+        if (vkAllocateCommandBuffers(lveDevice.vkDevice(), &allocInfo, &batch->transferCommands) !=
+            VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to allocate transfer command buffer!");
+        }
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(
+                lveDevice.vkDevice(), &semaphoreInfo, nullptr, &batch->releaseSemaphore) !=
+                VK_SUCCESS ||
+            vkCreateSemaphore(
+                lveDevice.vkDevice(), &semaphoreInfo, nullptr, &batch->transferSemaphore) !=
+                VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to create transfer semaphores!");
+        }
+    }
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(lveDevice.vkDevice(), &fenceInfo, nullptr, &batch->fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create transfer fence!");
+    }
+    return batch;
+}
+
+void TransferContext::destroyBatch(Batch &batch)
+{
+    VkDevice device = lveDevice.vkDevice();
+    vkDestroyFence(device, batch.fence, nullptr);
+    vkFreeCommandBuffers(device, graphicsCommandPool, 1, &batch.graphicsCommands);
+    if (dedicatedQueue)
+    {
+        vkFreeCommandBuffers(device, graphicsCommandPool, 1, &batch.releaseCommands);
+        vkFreeCommandBuffers(device, transferCommandPool, 1, &batch.transferCommands);
+        vkDestroySemaphore(device, batch.releaseSemaphore, nullptr);
+        vkDestroySemaphore(device, batch.transferSemaphore, nullptr);
+    }
+}
+
+TransferContext::Batch &TransferContext::getOpenBatch()
+{
+    if (!openBatch)
+    {
+        retireFinishedBatches();
+        if (freeBatches.empty())
+        {
+            openBatch = createBatch();
+        }
+        else
+        {
+            openBatch = std::move(freeBatches.back());
+            freeBatches.pop_back();
+        }
+        openBatch->ticket = nextTicket++;
+    }
+    return *openBatch;
+}
+
+static void beginCommands(VkCommandBuffer commandBuffer)
+{
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to begin recording transfer command buffer!");
+    }
+}
+
+static void endCommands(VkCommandBuffer commandBuffer)
+{
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to record transfer command buffer!");
+    }
+}
+
+uint64_t TransferContext::submitOpenBatch()
+{
+    if (!openBatch)
+        return 0;
+    std::unique_ptr<Batch> batch = std::move(openBatch);
+
+    if (dedicatedQueue && !batch->copies.empty())
+    {
+        submitDedicated(*batch);
+    }
+    else
+    {
+        recordSameQueue(*batch);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch->graphicsCommands;
+
+        std::lock_guard<std::mutex> lock(lveDevice.getQueueMutex());
+        if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &submitInfo, batch->fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit transfer command buffer!");
+        }
+    }
+
+    uint64_t ticket = batch->ticket;
+    submittedBatches.push_back(std::move(batch));
+    return ticket;
+}
+
+void TransferContext::recordSameQueue(Batch &batch)
+{
+    VkCommandBuffer commandBuffer = batch.graphicsCommands;
+    beginCommands(commandBuffer);
+
+    if (!batch.imageBarriers.empty())
+    {
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            static_cast<uint32_t>(batch.imageBarriers.size()),
+            batch.imageBarriers.data());
+    }
+
+    if (!batch.copies.empty())
+    {
+        // work submitted before, e.g. the previous frame, is done with the destinations
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+
+        for (const BufferCopy &copy : batch.copies)
+            vkCmdCopyBuffer(commandBuffer, copy.srcBuffer, copy.dstBuffer, 1, &copy.region);
+
+        // and work submitted after sees the copies
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0,
+            1,
+            &barrier,
+            0,
+            nullptr,
+            0,
+            nullptr);
+    }
+
+    endCommands(commandBuffer);
+}
+
+void TransferContext::submitDedicated(Batch &batch)
+{
+    std::vector<VkBuffer> dstBuffers;
+    for (const BufferCopy &copy : batch.copies)
+        dstBuffers.push_back(copy.dstBuffer);
+    std::sort(dstBuffers.begin(), dstBuffers.end());
+    dstBuffers.erase(std::unique(dstBuffers.begin(), dstBuffers.end()), dstBuffers.end());
+
+    // ownership transfers of the whole destination buffers, the release and the acquire of a
+    // transfer use the same barrier, each queue ignores the access mask of the other side
+    auto makeBarriers = [&](uint32_t srcFamily,
+                            uint32_t dstFamily,
+                            VkAccessFlags srcAccessMask,
+                            VkAccessFlags dstAccessMask) {
+        std::vector<VkBufferMemoryBarrier> barriers(dstBuffers.size());
+        for (size_t i = 0; i < dstBuffers.size(); i++)
+        {
+            barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barriers[i].srcAccessMask = srcAccessMask;
+            barriers[i].dstAccessMask = dstAccessMask;
+            barriers[i].srcQueueFamilyIndex = srcFamily;
+            barriers[i].dstQueueFamilyIndex = dstFamily;
+            barriers[i].buffer = dstBuffers[i];
+            barriers[i].offset = 0;
+            barriers[i].size = VK_WHOLE_SIZE;
+        }
+        return barriers;
+    };
+    const std::vector<VkBufferMemoryBarrier> toTransfer = makeBarriers(
+        graphicsFamily, transferFamily, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    const std::vector<VkBufferMemoryBarrier> toGraphics = makeBarriers(
+        transferFamily,
+        graphicsFamily,
+        VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT);
+    const uint32_t barrierCount = static_cast<uint32_t>(dstBuffers.size());
+
+    // graphics queue releases the destinations once the work before is done with them
+    beginCommands(batch.releaseCommands);
+    vkCmdPipelineBarrier(
+        batch.releaseCommands,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0,
+        nullptr,
+        barrierCount,
+        toTransfer.data(),
+        0,
+        nullptr);
+    endCommands(batch.releaseCommands);
+
+    // transfer queue acquires, copies and releases them again
+    beginCommands(batch.transferCommands);
+    vkCmdPipelineBarrier(
+        batch.transferCommands,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0,
+        nullptr,
+        barrierCount,
+        toTransfer.data(),
+        0,
+        nullptr);
+    for (const BufferCopy &copy : batch.copies)
+        vkCmdCopyBuffer(batch.transferCommands, copy.srcBuffer, copy.dstBuffer, 1, &copy.region);
+    vkCmdPipelineBarrier(
+        batch.transferCommands,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        0,
+        0,
+        nullptr,
+        barrierCount,
+        toGraphics.data(),
+        0,
+        nullptr);
+    endCommands(batch.transferCommands);
+
+    // graphics queue acquires them back for the work after, layout transitions run here as well
+    beginCommands(batch.graphicsCommands);
+    vkCmdPipelineBarrier(
+        batch.graphicsCommands,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        0,
+        nullptr,
+        barrierCount,
+        toGraphics.data(),
+        static_cast<uint32_t>(batch.imageBarriers.size()),
+        batch.imageBarriers.data());
+    endCommands(batch.graphicsCommands);
+
+    VkPipelineStageFlags transferWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    VkPipelineStageFlags graphicsWaitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo releaseInfo{};
+    releaseInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    releaseInfo.commandBufferCount = 1;
+    releaseInfo.pCommandBuffers = &batch.releaseCommands;
+    releaseInfo.signalSemaphoreCount = 1;
+    releaseInfo.pSignalSemaphores = &batch.releaseSemaphore;
+
+    VkSubmitInfo transferInfo{};
+    transferInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    transferInfo.waitSemaphoreCount = 1;
+    transferInfo.pWaitSemaphores = &batch.releaseSemaphore;
+    transferInfo.pWaitDstStageMask = &transferWaitStage;
+    transferInfo.commandBufferCount = 1;
+    transferInfo.pCommandBuffers = &batch.transferCommands;
+    transferInfo.signalSemaphoreCount = 1;
+    transferInfo.pSignalSemaphores = &batch.transferSemaphore;
+
+    VkSubmitInfo acquireInfo{};
+    acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquireInfo.waitSemaphoreCount = 1;
+    acquireInfo.pWaitSemaphores = &batch.transferSemaphore;
+    acquireInfo.pWaitDstStageMask = &graphicsWaitStage;
+    acquireInfo.commandBufferCount = 1;
+    acquireInfo.pCommandBuffers = &batch.graphicsCommands;
+
+    // a binary semaphore wait has to be submitted after its signal
+    std::lock_guard<std::mutex> lock(lveDevice.getQueueMutex());
+    if (vkQueueSubmit(lveDevice.graphicsQueue(), 1, &releaseInfo, VK_NULL_HANDLE) != VK_SUCCESS ||
+        vkQueueSubmit(lveDevice.transferQueue(), 1, &transferInfo, VK_NULL_HANDLE) != VK_SUCCESS ||
+        vkQueueSubmit(lveDevice.graphicsQueue(), 1, &acquireInfo, batch.fence) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to submit transfer command buffers!");
+    }
+}
+
+void TransferContext::retireFinishedBatches()
+{
+    // batches finish in submission order, the fence of the last submit signals last
+    while (!submittedBatches.empty() && submittedBatches.front()->waiterCount == 0 &&
+           vkGetFenceStatus(lveDevice.vkDevice(), submittedBatches.front()->fence) == VK_SUCCESS)
+    {
+        std::unique_ptr<Batch> batch = std::move(submittedBatches.front());
+        submittedBatches.pop_front();
+
+        vkResetFences(lveDevice.vkDevice(), 1, &batch->fence);
+        batch->copies.clear();
+        batch->imageBarriers.clear();
+        freeBatches.push_back(std::move(batch));
+    }
+}
+} // namespace lve
@@ -0,0 +1,140 @@
+#pragma once
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve
+{
+class Device;
+
+/*
+ * Batches buffer copies and image layout transitions into one submission instead of a blocking
+ * single time command per call. Everything recorded goes into the open batch, submit() hands it to
+ * the queue with a fence and returns right away, FrameManager::endFrame submits the open batch
+ * before the frame, so the frame sees its uploads. Every batch is identified by a ticket, wait()
+ * blocks on the fence of one batch instead of idling the queue.
+ *
+ * If the device has a queue family with transfer but without graphics support, the copies run on
+ * that queue. The destination buffers are then released by the graphics queue, acquired and
+ * written by the transfer queue and acquired back by the graphics queue, ordered by semaphores.
+ * Source buffers are expected to be staging buffers only read by copies. Layout transitions
+ * always run on the graphics queue.
+ *
+ * Every thread may record, submit and wait. Waiting on a fence does not hold the lock, so other
+ * threads keep recording meanwhile. A source written again for the next copy is written under a
+ * SourceWriteGuard, so no thread submits its batch halfway through the write.
+ */
+class TransferContext
+{
+public:
+    explicit TransferContext(Device &device);
+    ~TransferContext();
+
+    TransferContext(const TransferContext &) = delete;
+    TransferContext &operator=(const TransferContext &) = delete;
+
+    // record into the open batch and return its ticket, the sources are read when the batch runs
+    uint64_t copyBuffer(
+        VkBuffer srcBuffer,
+        VkBuffer dstBuffer,
+        VkDeviceSize size,
+        VkDeviceSize srcOffset = 0,
+        VkDeviceSize dstOffset = 0);
+    uint64_t transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+    // submits the open batch without waiting for it, returns its ticket, 0 if nothing was recorded
+    uint64_t submit();
+    // blocks until the batch of ticket finished, submits it first if it is still open
+    void wait(uint64_t ticket);
+
+    // holds off the submission of the open batch while its sources are written
+    class SourceWriteGuard
+    {
+    public:
+        SourceWriteGuard() = default;
+        ~SourceWriteGuard() { release(); }
+
+        SourceWriteGuard(const SourceWriteGuard &) = delete;
+        SourceWriteGuard &operator=(const SourceWriteGuard &) = delete;
+        SourceWriteGuard(SourceWriteGuard &&other) : context{other.context}
+        {
+            other.context = nullptr;
+        }
+        SourceWriteGuard &operator=(SourceWriteGuard &&other);
+
+        void release();
+
+    private:
+        friend class TransferContext;
+        explicit SourceWriteGuard(TransferContext *context) : context{context} {}
+
+        TransferContext *context = nullptr; // null if no batch is held off
+    };
+    // the sources of the batch of ticket may be written while the guard lives. A submitted batch
+    // is waited for, an open batch has not read them yet and is not submitted before the guard is
+    // released, submit and wait of other threads block until then. The thread holding the guard
+    // must not submit or wait itself before releasing it.
+    [[nodiscard]] SourceWriteGuard beginSourceWrite(uint64_t ticket);
+
+    bool hasDedicatedQueue() const { return dedicatedQueue; }
+
+private:
+    struct BufferCopy
+    {
+        VkBuffer srcBuffer;
+        VkBuffer dstBuffer;
+        VkBufferCopy region;
+    };
+
+    struct Batch
+    {
+        uint64_t ticket = 0;
+        std::vector<BufferCopy> copies;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+
+        uint32_t sourceWriterCount = 0; // guards holding off the submission of the open batch
+        uint32_t waiterCount = 0;       // threads waiting on the fence, it is not reset meanwhile
+
+        VkFence fence = VK_NULL_HANDLE;
+        VkCommandBuffer graphicsCommands; // everything without a dedicated queue
+        // with a dedicated queue only
+        VkCommandBuffer releaseCommands;  // graphics queue releases the destinations
+        VkCommandBuffer transferCommands; // transfer queue copies
+        VkSemaphore releaseSemaphore = VK_NULL_HANDLE;
+        VkSemaphore transferSemaphore = VK_NULL_HANDLE;
+    };
+
+    Device &lveDevice;
+    bool dedicatedQueue;
+    uint32_t graphicsFamily;
+    uint32_t transferFamily;
+    VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+    VkCommandPool transferCommandPool = VK_NULL_HANDLE;
+
+    std::mutex mutex;
+    std::condition_variable sourceWritesDone;
+    std::unique_ptr<Batch> openBatch;
+    std::deque<std::unique_ptr<Batch>> submittedBatches; // in ticket order
+    std::vector<std::unique_ptr<Batch>> freeBatches;
+    uint64_t nextTicket = 1;
+
+    VkCommandPool createCommandPool(uint32_t queueFamily);
+    std::unique_ptr<Batch> createBatch();
+    void destroyBatch(Batch &batch);
+    Batch &getOpenBatch();
+    uint64_t submitOpenBatch();
+    void waitForBatch(std::unique_lock<std::mutex> &lock, uint64_t ticket);
+    void endSourceWrite();
+    void recordSameQueue(Batch &batch);
+    void submitDedicated(Batch &batch);
+    void retireFinishedBatches();
+};
+} // namespace lve
@@ -1,5 +1,8 @@
 #include "line.hpp"
 
+// lve
+#include "lve/core/transfer_context.hpp"
+
 // std
 #include <memory>
 #include <stdexcept>
@@ -46,7 +49,6 @@ void LineCollection::createLineBuffer()
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
     stagingBuffer->map();
-    stagingBuffer->writeToBuffer((void *)lines.data());
 
     lineBuffer = std::make_unique<Buffer>(
         lveDevice,
@@ -54,8 +56,6 @@ void LineCollection::createLineBuffer()
         totalLineCount,
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    lineBuffer->copyBufferFrom(stagingBuffer->getBuffer(), lineSize * maxLineCount);
 }
 
 void LineCollection::bind(VkCommandBuffer commandBuffer)
@@ -99,7 +99,16 @@ void LineCollection::clearLines()
 
 void LineCollection::updateBuffer()
 {
-    stagingBuffer->writeToBuffer((void *)lines.data());
-    lineBuffer->copyBufferFrom(stagingBuffer->getBuffer(), sizeof(Line) * maxLineCount);
+    // the copy of the last update might not have read the staging buffer yet, and no other
+    // thread submits it while the staging buffer is written
+    TransferContext::SourceWriteGuard sourceWriteGuard =
+        lveDevice.getTransferContext().beginSourceWrite(uploadTicket);
+    if (lines.empty())
+        return;
+
+    // recorded into the transfer batch that FrameManager::endFrame submits before the frame
+    VkDeviceSize size = sizeof(Line) * lines.size();
+    stagingBuffer->writeToBuffer((void *)lines.data(), size);
+    uploadTicket = lineBuffer->recordCopyFrom(stagingBuffer->getBuffer(), size);
 }
-} // namespace lve
\ No newline at end of file
+} // namespace lve
@@ -73,6 +73,7 @@ private:
     std::unique_ptr<Buffer> lineBuffer;
     std::unique_ptr<Buffer> stagingBuffer;
     std::vector<Line> lines;
+    uint64_t uploadTicket = 0; // transfer batch of the last update
     size_t maxLineCount;
 };
 } // namespace lve
\ No newline at end of file
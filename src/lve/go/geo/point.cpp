@@ -1,5 +1,8 @@
 #include "point.hpp"
 
+// lve
+#include "lve/core/transfer_context.hpp"
+
 namespace lve
 {
 std::vector<VkVertexInputBindingDescription> Point::getBindingDescriptions()
@@ -42,7 +45,6 @@ void PointCollection::createBuffers()
         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
     stagingBuffer->map();
-    stagingBuffer->writeToBuffer((void *)points.data());
 
     pointBuffer = std::make_unique<Buffer>(
         lveDevice,
@@ -50,8 +52,6 @@ void PointCollection::createBuffers()
         totalPointSize,
         VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    pointBuffer->copyBufferFrom(stagingBuffer->getBuffer(), pointSize * maxPointCount);
 }
 
 void PointCollection::bind(VkCommandBuffer commandBuffer)
@@ -95,7 +95,16 @@ void PointCollection::clearPoints()
 
 void PointCollection::updateBuffer()
 {
-    stagingBuffer->writeToBuffer((void *)points.data());
-    pointBuffer->copyBufferFrom(stagingBuffer->getBuffer(), sizeof(Point) * maxPointCount);
+    // the copy of the last update might not have read the staging buffer yet, and no other
+    // thread submits it while the staging buffer is written
+    TransferContext::SourceWriteGuard sourceWriteGuard =
+        lveDevice.getTransferContext().beginSourceWrite(uploadTicket);
+    if (points.empty())
+        return;
+
+    // recorded into the transfer batch that FrameManager::endFrame submits before the frame
+    VkDeviceSize size = sizeof(Point) * points.size();
+    stagingBuffer->writeToBuffer((void *)points.data(), size);
+    uploadTicket = pointBuffer->recordCopyFrom(stagingBuffer->getBuffer(), size);
 }
-} // namespace lve
\ No newline at end of file
+} // namespace lve
@@ -66,6 +66,7 @@ private:
     std::unique_ptr<Buffer> pointBuffer;
     std::unique_ptr<Buffer> stagingBuffer;
     std::vector<Point> points;
+    uint64_t uploadTicket = 0; // transfer batch of the last update
     size_t maxPointCount;
 };
 } // namespace lve
\ No newline at end of file
@@ -4,10 +4,16 @@ namespace lve::path::config
 {
 const std::string ROOT = "config/";
 const std::string FLUID_SIM_2D = ROOT + "fluidSim2D.yaml";
+const std::string MPM_2D = ROOT + "mpm2D.yaml";
 } // namespace lve::path::config
 
 namespace lve::path::asset
 {
 const std::string SHADER = "shaders/";
 const std::string MODEL = "assets/models/";
-} // namespace lve::path::asset
\ No newline at end of file
+} // namespace lve::path::asset
+
+namespace lve::path::cache
+{
+const std::string ROOT = "cache/";
+} // namespace lve::path::cache
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "checkpoint.hpp"
+
+// std
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace lve
+{
+namespace
+{
+size_t alignSectionOffset(size_t offset)
+{
+    return (offset + checkpoint::SECTION_ALIGNMENT - 1) / checkpoint::SECTION_ALIGNMENT *
+        checkpoint::SECTION_ALIGNMENT;
+}
+
+void copyName(char (&destination)[checkpoint::NAME_SIZE], const std::string &name)
+{
+    if (name.empty() || name.size() >= checkpoint::NAME_SIZE)
+        throw std::runtime_error("Invalid checkpoint name: " + name);
+    std::memset(destination, 0, checkpoint::NAME_SIZE);
+    std::memcpy(destination, name.data(), name.size());
+}
+} // namespace
+
+CheckpointWriter::CheckpointWriter(const std::string &kind, uint32_t kindVersion)
+    : kind(kind), kindVersion(kindVersion)
+{
+}
+
+void CheckpointWriter::addSection(const std::string &name, const void *data, size_t size)
+{
+    for (const Section &section : sections)
+        if (section.name == name)
+            throw std::runtime_error("Duplicate checkpoint section: " + name);
+
+    const char *bytes = static_cast<const char *>(data);
+    sections.push_back({name, std::vector<char>(bytes, bytes + size)});
+}
+
+void CheckpointWriter::write(const std::string &filePath) const
+{
+    checkpoint::Header header{};
+    std::memcpy(header.magic, checkpoint::MAGIC, sizeof(header.magic));
+    header.formatVersion = checkpoint::FORMAT_VERSION;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    copyName(header.kind, kind);
+    header.kindVersion = kindVersion;
+
+    std::vector<checkpoint::SectionEntry> entries(sections.size());
+    size_t offset = sizeof(header) + entries.size() * sizeof(checkpoint::SectionEntry);
+    for (size_t i = 0; i < sections.size(); i++)
+    {
+        offset = alignSectionOffset(offset);
+        copyName(entries[i].name, sections[i].name);
+        entries[i].offset = offset;
+        entries[i].size = sections[i].data.size();
+        offset += sections[i].data.size();
+    }
+
+    std::vector<char> file(offset, 0);
+    std::memcpy(file.data(), &header, sizeof(header));
+    std::memcpy(file.data() + sizeof(header), entries.data(), entries.size() * sizeof(entries[0]));
+    for (size_t i = 0; i < sections.size(); i++)
+        std::memcpy(file.data() + entries[i].offset, sections[i].data.data(), entries[i].size);
+
+    std::ofstream stream{filePath, std::ios::binary};
+    if (!stream.is_open())
+        throw std::runtime_error("Failed to open file: " + filePath);
+    stream.write(file.data(), file.size());
+    if (!stream)
+        throw std::runtime_error("Failed to write checkpoint: " + filePath);
+}
+
+CheckpointReader::CheckpointReader(const std::string &filePath) : filePath(filePath)
+{
+    std::ifstream stream{filePath, std::ios::binary | std::ios::ate};
+    if (!stream.is_open())
+        throw std::runtime_error("Failed to open file: " + filePath);
+    data.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(data.data(), data.size());
+
+    if (data.size() < sizeof(checkpoint::Header) ||
+        std::memcmp(header().magic, checkpoint::MAGIC, sizeof(checkpoint::MAGIC)) != 0)
+        throw std::runtime_error("Not a checkpoint: " + filePath);
+    if (header().formatVersion != checkpoint::FORMAT_VERSION)
+        throw std::runtime_error(
+            "Unsupported checkpoint format version " + std::to_string(header().formatVersion) +
+            ": " + filePath);
+
+    size_t tableEnd = sizeof(checkpoint::Header) +
+        header().sectionCount * sizeof(checkpoint::SectionEntry);
+    if (data.size() < tableEnd)
+        throw std::runtime_error("Truncated checkpoint: " + filePath);
+    const checkpoint::SectionEntry *entries = reinterpret_cast<const checkpoint::SectionEntry *>(
+        data.data() + sizeof(checkpoint::Header));
+    for (uint32_t i = 0; i < header().sectionCount; i++)
+        if (entries[i].offset > data.size() || entries[i].size > data.size() - entries[i].offset)
+            throw std::runtime_error("Truncated checkpoint: " + filePath);
+}
+
+std::string CheckpointReader::getKind() const
+{
+    return std::string(header().kind, strnlen(header().kind, checkpoint::NAME_SIZE));
+}
+
+void CheckpointReader::checkKind(const std::string &expectedKind, uint32_t expectedVersion) const
+{
+    if (getKind() != expectedKind)
+        throw std::runtime_error(
+            "Checkpoint holds " + getKind() + ", expected " + expectedKind + ": " + filePath);
+    if (header().kindVersion != expectedVersion)
+        throw std::runtime_error(
+            "Unsupported " + expectedKind + " checkpoint version " +
+            std::to_string(header().kindVersion) + ": " + filePath);
+}
+
+bool CheckpointReader::hasSection(const std::string &name) const
+{
+    return findSection(name) != nullptr;
+}
+
+const void *CheckpointReader::getSection(const std::string &name, size_t &size) const
+{
+    const checkpoint::SectionEntry *entry = findSection(name);
+    if (!entry)
+        throw std::runtime_error("Checkpoint section not found: " + name + ": " + filePath);
+    size = entry->size;
+    return data.data() + entry->offset;
+}
+
+const checkpoint::Header &CheckpointReader::header() const
+{
+    return *reinterpret_cast<const checkpoint::Header *>(data.data());
+}
+
+const checkpoint::SectionEntry *CheckpointReader::findSection(const std::string &name) const
+{
+    const checkpoint::SectionEntry *entries = reinterpret_cast<const checkpoint::SectionEntry *>(
+        data.data() + sizeof(checkpoint::Header));
+    for (uint32_t i = 0; i < header().sectionCount; i++)
+        if (std::strncmp(entries[i].name, name.c_str(), checkpoint::NAME_SIZE) == 0)
+            return &entries[i];
+    return nullptr;
+}
+} // namespace lve
@@ -0,0 +1,99 @@
+#pragma once
+
+// lve
+#include "lve/util/aligned_allocator.hpp"
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lve
+{
+/*
+ * Versioned binary checkpoint made of named sections. Every section starts at a 64 byte aligned
+ * offset, so a memory mapped file, or the buffer CheckpointReader loads it into, can be used in
+ * place, e.g. as aligned simd particle arrays. Values are stored in the byte order of the writer.
+ *
+ * layout: Header | SectionEntry[sectionCount] | padding | section 0 | padding | section 1 ...
+ */
+namespace checkpoint
+{
+constexpr char MAGIC[8] = {'L', 'V', 'E', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t FORMAT_VERSION = 1;
+constexpr size_t SECTION_ALIGNMENT = 64;
+constexpr size_t NAME_SIZE = 32; // including the terminating zero
+
+struct Header
+{
+    char magic[8];
+    uint32_t formatVersion;
+    uint32_t sectionCount;
+    char kind[NAME_SIZE]; // what the checkpoint holds, e.g. "sph"
+    uint32_t kindVersion; // layout version of that kind
+    uint32_t reserved[3];
+};
+
+struct SectionEntry
+{
+    char name[NAME_SIZE];
+    uint64_t offset; // from the start of the file
+    uint64_t size;   // in bytes
+};
+} // namespace checkpoint
+
+class CheckpointWriter
+{
+public:
+    CheckpointWriter(const std::string &kind, uint32_t kindVersion);
+
+    // data is copied, section names are unique and shorter than checkpoint::NAME_SIZE
+    void addSection(const std::string &name, const void *data, size_t size);
+    template <typename T, typename Allocator>
+    void addArray(const std::string &name, const std::vector<T, Allocator> &array);
+    template <typename T>
+    void addValue(const std::string &name, const T &value);
+
+    void write(const std::string &filePath) const;
+
+private:
+    struct Section
+    {
+        std::string name;
+        std::vector<char> data;
+    };
+
+    std::string kind;
+    uint32_t kindVersion;
+    std::vector<Section> sections;
+};
+
+class CheckpointReader
+{
+public:
+    CheckpointReader(const std::string &filePath); // throws if the file is not a checkpoint
+
+    // throws unless the checkpoint holds the given kind in the given layout version
+    void checkKind(const std::string &expectedKind, uint32_t expectedVersion) const;
+    std::string getKind() const;
+
+    bool hasSection(const std::string &name) const;
+    const void *getSection(const std::string &name, size_t &size) const;
+    template <typename T>
+    const T *getArray(const std::string &name, size_t count) const; // throws if the size differs
+    template <typename T>
+    size_t getArraySize(const std::string &name) const;
+    template <typename T>
+    T getValue(const std::string &name) const;
+
+private:
+    std::string filePath;
+    std::vector<char, AlignedAllocator<char, checkpoint::SECTION_ALIGNMENT>> data;
+
+    const checkpoint::Header &header() const;
+    const checkpoint::SectionEntry *findSection(const std::string &name) const;
+};
+} // namespace lve
+
+#include "checkpoint.tpp"
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "checkpoint.hpp"
+
+// std
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace lve
+{
+template <typename T, typename Allocator>
+void CheckpointWriter::addArray(const std::string &name, const std::vector<T, Allocator> &array)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "checkpoint arrays are stored as raw bytes");
+    addSection(name, array.data(), array.size() * sizeof(T));
+}
+
+template <typename T>
+void CheckpointWriter::addValue(const std::string &name, const T &value)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "checkpoint values are stored as raw bytes");
+    addSection(name, &value, sizeof(T));
+}
+
+template <typename T>
+const T *CheckpointReader::getArray(const std::string &name, size_t count) const
+{
+    size_t size;
+    const void *section = getSection(name, size);
+    if (size != count * sizeof(T))
+        throw std::runtime_error(
+            "Checkpoint section " + name + " has " + std::to_string(size) + " bytes, expected " +
+            std::to_string(count * sizeof(T)) + ": " + filePath);
+    return static_cast<const T *>(section);
+}
+
+template <typename T>
+size_t CheckpointReader::getArraySize(const std::string &name) const
+{
+    size_t size;
+    getSection(name, size);
+    if (size % sizeof(T) != 0)
+        throw std::runtime_error("Checkpoint section " + name + " is not an array: " + filePath);
+    return size / sizeof(T);
+}
+
+template <typename T>
+T CheckpointReader::getValue(const std::string &name) const
+{
+    T value;
+    std::memcpy(&value, getArray<T>(name, 1), sizeof(T));
+    return value;
+}
+} // namespace lve
@@ -0,0 +1,83 @@
+#include "cpu.hpp"
+
+#if defined(LVE_ARCH_X86) && defined(_MSC_VER)
+    #include <immintrin.h>
+    #include <intrin.h>
+#endif
+
+namespace lve::cpu
+{
+namespace
+{
+SimdLevel detectSimdLevel()
+{
+#if defined(LVE_ARCH_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    bool avx2 = false;
+    bool avx512f = false;
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512f = (info[1] & (1 << 16)) != 0;
+    }
+
+    // the os has to save the wider registers on context switch, checked through XCR0
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymmEnabled = (xcr0 & 0x6) == 0x6;
+    bool zmmEnabled = (xcr0 & 0xe6) == 0xe6;
+
+    if (avx512f && avx2 && avx && zmmEnabled)
+        return SIMD_AVX512;
+    if (avx2 && avx && ymmEnabled)
+        return SIMD_AVX2;
+    if (sse41)
+        return SIMD_SSE4;
+    return SIMD_SCALAR;
+#elif defined(LVE_ARCH_X86) && defined(__GNUC__)
+    // checks os support of the extended registers as well
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.1"))
+        return SIMD_SSE4;
+    return SIMD_SCALAR;
+#else
+    return SIMD_SCALAR;
+#endif
+}
+} // namespace
+
+SimdLevel getSimdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+const char *getSimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SIMD_SCALAR:
+        return "scalar";
+    case SIMD_SSE4:
+        return "sse4";
+    case SIMD_AVX2:
+        return "avx2";
+    case SIMD_AVX512:
+        return "avx512";
+    default:
+        return "unknown";
+    }
+}
+} // namespace lve::cpu
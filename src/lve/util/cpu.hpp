@@ -0,0 +1,21 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define LVE_ARCH_X86
+#endif
+
+namespace lve::cpu
+{
+// instruction set tiers used by runtime dispatched kernels, ordered from lowest to highest
+enum SimdLevel
+{
+    SIMD_SCALAR,
+    SIMD_SSE4,
+    SIMD_AVX2,
+    SIMD_AVX512,
+    SIMD_LEVEL_COUNT
+};
+
+SimdLevel getSimdLevel(); // highest level supported by both the cpu and the os, detected once
+const char *getSimdLevelName(SimdLevel level);
+} // namespace lve::cpu
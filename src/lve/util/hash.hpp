@@ -2,6 +2,7 @@
 
 // std
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
 namespace lve
@@ -25,4 +26,14 @@ std::size_t hash(const std::vector<T> &v)
     }
     return seed;
 }
+
+// FNV-1a of raw bytes, unlike std::hash the same on every platform and run, chain calls with seed
+constexpr uint64_t HASH_BYTES_SEED = 0xcbf29ce484222325ull;
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = HASH_BYTES_SEED)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++)
+        seed = (seed ^ bytes[i]) * 0x100000001b3ull;
+    return seed;
+}
 } // namespace lve
\ No newline at end of file
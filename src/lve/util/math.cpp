@@ -1,7 +1,54 @@
 #include "math.hpp"
 
+// std
+#include <cmath>
+#include <utility>
+
 namespace lve::math
 {
+glm::mat2 polarRotation(const glm::mat2 &m)
+{
+    // angle of the rotation closest to m, glm matrices are indexed [column][row]
+    float angle = std::atan2(m[0][1] - m[1][0], m[0][0] + m[1][1]);
+    float cos = std::cos(angle);
+    float sin = std::sin(angle);
+    return glm::mat2(cos, sin, -sin, cos);
+}
+
+// polar decomposition followed by a jacobi rotation diagonalizing the symmetric factor
+Svd2 svd(const glm::mat2 &m)
+{
+    glm::mat2 r = polarRotation(m);
+    glm::mat2 s = glm::transpose(r) * m;
+    float s00 = s[0][0];
+    float s01 = s[1][0];
+    float s11 = s[1][1];
+
+    float cos = 1.0f;
+    float sin = 0.0f;
+    glm::vec2 sigma = glm::vec2(s00, s11);
+    if (std::abs(s01) > 1e-6f)
+    {
+        float tau = 0.5f * (s00 - s11);
+        float w = std::sqrt(tau * tau + s01 * s01);
+        float t = tau > 0.0f ? s01 / (tau + w) : s01 / (tau - w);
+        cos = 1.0f / std::sqrt(t * t + 1.0f);
+        sin = -t * cos;
+        sigma.x = cos * cos * s00 - 2.0f * cos * sin * s01 + sin * sin * s11;
+        sigma.y = sin * sin * s00 + 2.0f * cos * sin * s01 + cos * cos * s11;
+    }
+
+    glm::mat2 v;
+    if (sigma.x < sigma.y)
+    {
+        std::swap(sigma.x, sigma.y);
+        v = glm::mat2(-sin, -cos, cos, -sin);
+    }
+    else
+        v = glm::mat2(cos, -sin, sin, cos);
+    return {r * v, sigma, v};
+}
+
 unsigned int positiveMod(int value, unsigned int m)
 {
     int mod = value % (int)m;
@@ -10,6 +57,17 @@ unsigned int positiveMod(int value, unsigned int m)
     return mod;
 }
 
+// integer hash with good avalanche, from: https://github.com/skeeto/hash-prospector
+uint32_t hashUint32(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
 float fastInvSqrt(float x)
 {
     long i;
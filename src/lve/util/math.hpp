@@ -9,6 +9,7 @@
 
 // std
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <math.h>
 
@@ -47,7 +48,19 @@ T trace(const glm::mat<4, 4, T, Q> &mat)
     return mat[0][0] + mat[1][1] + mat[2][2] + mat[3][3];
 }
 
+// m = u * diag(sigma) * transpose(v) with rotations u, v and sigma.x >= sigma.y
+struct Svd2
+{
+    glm::mat2 u;
+    glm::vec2 sigma;
+    glm::mat2 v;
+};
+// rotation r of the polar decomposition m = r * s with a symmetric s
+glm::mat2 polarRotation(const glm::mat2 &m);
+Svd2 svd(const glm::mat2 &m);
+
 unsigned int positiveMod(int value, unsigned int m);
+uint32_t hashUint32(uint32_t x);
 float fastInvSqrt(float x);
 float fastSqrt(float x);
 } // namespace lve::math
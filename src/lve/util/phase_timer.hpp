@@ -0,0 +1,42 @@
+#pragma once
+
+// std
+#include <array>
+#include <chrono>
+#include <cstddef>
+
+namespace lve
+{
+/*
+ * Accumulates wall time spent in consecutive phases of a repeated task, e.g. the stages of a
+ * solver step. Call start() at the beginning of the task and lap(phase) at the end of each phase,
+ * or add durations measured elsewhere, e.g. gpu timestamps, with add(phase, seconds).
+ */
+template <size_t PhaseCount>
+class PhaseTimer
+{
+public:
+    void start() { lapStartTime = std::chrono::steady_clock::now(); }
+    void lap(size_t phase)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        phaseDurations[phase] += std::chrono::duration<double>(now - lapStartTime).count();
+        lapStartTime = now;
+    }
+    void add(size_t phase, double seconds) { phaseDurations[phase] += seconds; }
+    void reset() { phaseDurations.fill(0.0); }
+
+    double getDuration(size_t phase) const { return phaseDurations[phase]; } // in seconds
+    double getTotalDuration() const
+    {
+        double total = 0.0;
+        for (double duration : phaseDurations)
+            total += duration;
+        return total;
+    }
+
+private:
+    std::chrono::steady_clock::time_point lapStartTime;
+    std::array<double, PhaseCount> phaseDurations{};
+};
+} // namespace lve
@@ -0,0 +1,53 @@
+#pragma once
+
+// std
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace lve
+{
+/*
+ * Lock-free single producer, single consumer triple buffer. The writer fills getWriteBuffer() and
+ * publishes it, the reader calls update() to switch to the latest published buffer and reads
+ * getReadBuffer() until the next update. Neither side ever blocks or waits for the other, the
+ * writer may publish any number of times between two reads and only the latest one is seen.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+    // writer side
+    T &getWriteBuffer() { return buffers[writeIndex]; }
+    void publish()
+    {
+        uint8_t previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // reader side, returns false and keeps the current buffer if nothing new was published
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH_BIT))
+            return false;
+        uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+    const T &getReadBuffer() const { return buffers[readIndex]; }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH_BIT = 0x4; // set when the middle buffer has not been read yet
+
+    std::array<T, 3> buffers;
+    // writer and reader indices on their own cache lines, the threads never share them
+    alignas(64) uint8_t writeIndex = 0;
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t readIndex = 2;
+};
+} // namespace lve